@@ -202,6 +202,12 @@ public:
 		// The current output
 		return out[0];
 	}
+
+	// Once our filter state has decayed to silence, DSBee can skip us on silent input.
+	bool isIdle() const override
+	{
+		return IsSilent(in, 2) && IsSilent(out, 2);
+	}
 };
 
 
@@ -0,0 +1,411 @@
+#include "ci_responder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+
+using namespace dsbee;
+using namespace midi2;
+
+
+namespace
+{
+	const uint8_t AUTHORITY_ENDPOINT = 0x40;
+
+	const unsigned DISCOVERY_TRIES = 3;
+
+	// Replies to Set New Protocol must be tested and confirmed in time, or the old protocol returns.
+	const std::chrono::milliseconds NEGOTIATION_TIMEOUT(300);
+	const std::chrono::milliseconds DISCOVERY_RETRY    (1000);
+	const std::chrono::milliseconds PROPERTY_TIMEOUT   (3000);
+
+	bool Is7Bit(const std::string &bytes)
+	{
+		for (char c : bytes) if (uint8_t(c) & 0x80) return false;
+		return true;
+	}
+
+	uint32_t RandomMUID()
+	{
+		std::random_device random;
+		return uint32_t(random()) % MUID::SPECIAL_BEGIN;
+	}
+}
+
+
+CI_Responder::CI_Responder(const CI_Identity &identity, PropertyHandler onProperty,
+	size_t queueBytes, unsigned pollMilliseconds) :
+	PE_Receiver(MAX_PROPERTY * MAX_REQUESTS, MAX_REQUESTS),
+	identity(identity), onProperty(onProperty), pollMilliseconds(pollMilliseconds),
+	inbound(queueBytes), outbound(queueBytes), ownMuid(RandomMUID())
+{
+	drainScratch.reserve(MAX_MESSAGE + 2);
+	for (PartialRequest &p : partials) p.header.reserve(MAX_MESSAGE);
+	worker = std::thread(&CI_Responder::run, this);
+}
+
+CI_Responder::~CI_Responder()
+{
+	stopping = true;
+	if (worker.joinable()) worker.join();
+}
+
+
+bool CI_Responder::push(const SysEx_Event &event)
+{
+	const SysEx_Message &m = event.message;
+	if (!event.complete() || event.sysex8 || m.length < M::HEADER_SIZE || m.length > MAX_MESSAGE) return false;
+	if (m.bytes[0] != sysex::SYSEX_ID_UNIVERSAL || m.bytes[2] != sysex::SYSEX_SUBID1_MIDI_CI) return false;
+
+	return WriteRecord(inbound, m.bytes, uint32_t(m.length));
+}
+
+std::vector<CI_Responder::Peer> CI_Responder::peers() const
+{
+	std::lock_guard<std::mutex> lock(peerLock);
+	return peerTable;
+}
+
+
+bool CI_Responder::WriteRecord(RingBuffer<uint8_t> &queue, const uint8_t *bytes, uint32_t length, uint8_t prefix, uint8_t suffix)
+{
+	uint32_t total = length + (prefix ? 1 : 0) + (suffix ? 1 : 0);
+	RingSpan<uint8_t> span = queue.writeSpan(sizeof(total) + total);
+	if (span.frames() < sizeof(total) + total) return false;
+
+	// Copy the pieces across the two regions of the span.
+	size_t at = 0;
+	auto put = [&](const uint8_t *data, size_t n)
+	{
+		for (size_t i = 0; i < n; ++i, ++at)
+			(at < span.firstFrames ? span.first[at] : span.second[at - span.firstFrames]) = data[i];
+	};
+	put(reinterpret_cast<const uint8_t*>(&total), sizeof(total));
+	if (prefix) put(&prefix, 1);
+	put(bytes, length);
+	if (suffix) put(&suffix, 1);
+
+	queue.commitWrite(at);
+	return true;
+}
+
+bool CI_Responder::ReadRecord(RingBuffer<uint8_t> &queue, std::vector<uint8_t> &record)
+{
+	uint32_t length;
+	RingSpan<const uint8_t> span = queue.readSpan();
+	if (span.frames() < sizeof(length)) return false;
+
+	auto get = [&](size_t at) {return at < span.firstFrames ? span.first[at] : span.second[at - span.firstFrames];};
+	uint8_t *l = reinterpret_cast<uint8_t*>(&length);
+	for (size_t i = 0; i < sizeof(length); ++i) l[i] = get(i);
+	if (span.frames() < sizeof(length) + length) return false;
+
+	// Records too large for the reader's buffer are skipped, so the audio thread never allocates.
+	bool fits = (length <= record.capacity());
+	if (fits)
+	{
+		record.resize(length);
+		for (uint32_t i = 0; i < length; ++i) record[i] = get(sizeof(length) + i);
+	}
+	queue.commitRead(sizeof(length) + length);
+	return fits || ReadRecord(queue, record);
+}
+
+
+void CI_Responder::run()
+{
+	workScratch.reserve(MAX_MESSAGE);
+
+	while (!stopping)
+	{
+		while (ReadRecord(inbound, workScratch))
+			CI_Handler::receive(SysEx_Message{workScratch.data(), workScratch.size()});
+
+		service(Clock::now());
+		flush();
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(pollMilliseconds));
+	}
+}
+
+void CI_Responder::service(Clock::time_point now)
+{
+	// Look for other devices, a few times until one answers.
+	if (!discovered && discoveryTries < DISCOVERY_TRIES && (discoveryTries == 0 || now - discoveryTime >= DISCOVERY_RETRY))
+	{
+		M::Discovery inquiry(false, muid(), MUID::Broadcast(), identity);
+		inquiry.capabilities   = M::Discovery::CAN_PROTOCOL | M::Discovery::CAN_PROFILE | M::Discovery::CAN_PROPERTY;
+		inquiry.max_sysex_size = MAX_MESSAGE;
+		send(inquiry);
+
+		++discoveryTries;
+		discoveryTime = now;
+	}
+
+	// Protocol changes that weren't tested and confirmed in time are undone.
+	for (size_t i = 0; i < negotiations.size(); )
+	{
+		if (now < negotiations[i].deadline) {++i; continue;}
+		{
+			std::lock_guard<std::mutex> lock(peerLock);
+			if (Peer *p = peer(negotiations[i].muid, false)) p->protocol = negotiations[i].previous;
+		}
+		negotiations.erase(negotiations.begin() + i);
+	}
+
+	// Property requests missing chunks are abandoned.
+	for (PartialRequest &p : partials) if (p.active && now >= p.deadline)
+	{
+		abandon(p.source, p.requestId);
+		p.active = false;
+	}
+}
+
+void CI_Responder::flush()
+{
+	while (!outbox.empty())
+	{
+		const std::vector<uint8_t> &message = outbox.front();
+		if (!WriteRecord(outbound, message.data(), uint32_t(message.size()), 0xF0, 0xF7)) break;
+		outbox.pop_front();
+	}
+}
+
+CI_Responder::Peer *CI_Responder::peer(MUID muid, bool create)
+{
+	for (Peer &p : peerTable) if (p.muid == muid) return &p;
+	if (!create) return nullptr;
+
+	// Forget the peer heard from longest ago to make room.
+	if (peerTable.size() >= MAX_PEERS)
+	{
+		peerTable.erase(std::min_element(peerTable.begin(), peerTable.end(),
+			[](const Peer &a, const Peer &b) {return a.lastSeen < b.lastSeen;}));
+	}
+	peerTable.push_back(Peer());
+	peerTable.back().muid     = muid;
+	peerTable.back().protocol = protocols.back();
+	return &peerTable.back();
+}
+
+bool CI_Responder::addressed(const M::Base &m) const
+{
+	return m.destination() == muid() || m.destination().broadcast();
+}
+
+template<typename Message>
+void CI_Responder::send(const Message &message)
+{
+	std::vector<uint8_t> bytes(message.size());
+	SysEx_Writer writer(Byte_Buffer{bytes.data(), bytes.size()});
+	if (message.write(writer)) outbox.push_back(std::move(bytes));
+}
+
+
+void CI_Responder::on_discovery(const M::Discovery &m)
+{
+	// Someone else has our MUID:  give it up and choose another.
+	if (m.source() == muid())
+	{
+		send(M::InvalidateMUID(muid(), muid()));
+		ownMuid = RandomMUID();
+		discovered = false;
+		discoveryTries = 0;
+		return;
+	}
+	if (!addressed(m)) return;
+
+	{
+		std::lock_guard<std::mutex> lock(peerLock);
+		Peer *p = peer(m.source(), true);
+		p->identity     = m.identity;
+		p->capabilities = m.capabilities;
+		p->maxSysExSize = std::max<uint32_t>(m.max_sysex_size ? uint32_t(m.max_sysex_size) : uint32_t(MAX_MESSAGE), 128u);
+		p->lastSeen     = Clock::now();
+	}
+
+	if (m.is_reply()) discovered = true;
+	else
+	{
+		M::Discovery reply(true, muid(), m.source(), identity);
+		reply.capabilities   = M::Discovery::CAN_PROTOCOL | M::Discovery::CAN_PROFILE | M::Discovery::CAN_PROPERTY;
+		reply.max_sysex_size = MAX_MESSAGE;
+		send(reply);
+	}
+}
+
+void CI_Responder::on_invalidate(const M::InvalidateMUID &m)
+{
+	std::lock_guard<std::mutex> lock(peerLock);
+	peerTable.erase(std::remove_if(peerTable.begin(), peerTable.end(),
+		[&m](const Peer &p) {return p.muid == m.target;}), peerTable.end());
+}
+
+void CI_Responder::on_protocol_init(const M::ProtocolInit &m)
+{
+	if (!addressed(m) || m.ci_type() != M::PROT_INIT) return;
+
+	M::ProtocolInit reply(M::PROT_INIT_REPLY, muid(), m.source(), AUTHORITY_ENDPOINT);
+	reply.protocols = CI_List<sysex::UInt7, CI_Protocol>(protocols.data(), uint32_t(protocols.size()));
+	send(reply);
+}
+
+void CI_Responder::on_protocol_set(const M::ProtocolSet &m)
+{
+	if (!addressed(m)) return;
+	if (std::find(protocols.begin(), protocols.end(), m.protocol) == protocols.end()) return;
+
+	// Switch now;  the initiator tests and confirms, or we switch back.
+	CI_Protocol previous;
+	{
+		std::lock_guard<std::mutex> lock(peerLock);
+		Peer *p = peer(m.source(), true);
+		previous    = p->protocol;
+		p->protocol = m.protocol;
+		p->lastSeen = Clock::now();
+	}
+
+	// A second Set during a negotiation still falls back to the protocol from before the first.
+	for (Negotiation &n : negotiations) if (n.muid == m.source())
+	{
+		n.deadline = Clock::now() + NEGOTIATION_TIMEOUT;
+		return;
+	}
+	negotiations.push_back(Negotiation{m.source(), previous, Clock::now() + NEGOTIATION_TIMEOUT});
+}
+
+void CI_Responder::on_protocol_test(const M::ProtocolTest &m)
+{
+	if (!addressed(m) || m.ci_type() != M::PROT_TEST_I2R || !m.test_passed) return;
+
+	for (Negotiation &n : negotiations) if (n.muid == m.source()) n.deadline = Clock::now() + NEGOTIATION_TIMEOUT;
+	send(M::ProtocolTest(M::PROT_TEST_R2I, muid(), m.source(), AUTHORITY_ENDPOINT));
+}
+
+void CI_Responder::on_protocol_confirm(const M::ProtocolNegotiation &m)
+{
+	if (!addressed(m)) return;
+	negotiations.erase(std::remove_if(negotiations.begin(), negotiations.end(),
+		[&m](const Negotiation &n) {return n.muid == m.source();}), negotiations.end());
+}
+
+void CI_Responder::on_profile_inquiry(const M::Base &m)
+{
+	if (!addressed(m)) return;
+
+	M::ProfileInquiryReply reply(M::PROF_INQUIRY_REPLY, m.ci_channel(), muid(), m.source());
+	reply.enabled  = CI_List<sysex::UInt14, CI_ProfileId>(enabledProfiles .data(), uint32_t(enabledProfiles .size()));
+	reply.disabled = CI_List<sysex::UInt14, CI_ProfileId>(disabledProfiles.data(), uint32_t(disabledProfiles.size()));
+	send(reply);
+}
+
+void CI_Responder::on_property_caps(const M::PropertyCaps &m)
+{
+	if (!addressed(m) || m.ci_type() != M::PROP_CAPS_INQUIRY) return;
+
+	M::PropertyCaps reply(M::PROP_CAPS_REPLY, CI_CHANNEL_ALL, muid(), m.source());
+	reply.simultaneous_requests = 1;
+	send(reply);
+}
+
+void CI_Responder::on_property(const M::PropertyChunk &m)
+{
+	// Only inquiries (even types) and notifications are ours to handle.
+	if (!addressed(m) || !(m.ci_type() % 2 == 0 || m.ci_type() == M::PROP_NOTIFY)) return;
+
+	// PE_Receiver drops later chunks of a request we don't have (never started, or abandoned
+	//   after PROPERTY_TIMEOUT), and chunks of new requests while MAX_REQUESTS are in progress.
+	if (!PE_Receiver::receive(m)) return;
+	if (PartialRequest *p = partial(m, false)) p->deadline = Clock::now() + PROPERTY_TIMEOUT;
+}
+
+CI_Responder::PartialRequest *CI_Responder::partial(const Chunk &chunk, bool start)
+{
+	PartialRequest *free = nullptr;
+	for (PartialRequest &p : partials)
+	{
+		if (p.active && p.source == chunk.source() && p.requestId == chunk.request_id) return &p;
+		if (!p.active && !free) free = &p;
+	}
+	return start ? free : nullptr;
+}
+
+void CI_Responder::on_header(const Chunk &chunk, const PE_Header &)
+{
+	// PE_Receiver tracks as many requests as we do, so there is always room here.
+	PartialRequest *p = partial(chunk, true);
+	if (!p) return;
+	p->active    = true;
+	p->source    = chunk.source();
+	p->requestId = chunk.request_id;
+	p->header.assign((const char*) chunk.header.bytes, chunk.header.length);
+}
+
+void CI_Responder::on_complete(const Chunk &chunk, const PE_Header &header, const uint8_t *data, size_t length)
+{
+	PartialRequest *p = partial(chunk, false);
+	if (!p) return;
+	p->active = false;
+
+	// The header is lent to the request and taken back, keeping its storage.
+	PropertyRequest request = {chunk.ci_type(), chunk.source(), chunk.request_id, std::string(), header, data, length};
+	request.header.swap(p->header);
+	reply(request);
+	p->header.swap(request.header);
+}
+
+void CI_Responder::reply(const PropertyRequest &request)
+{
+	// Data larger than MAX_PROPERTY wasn't collected, so it never reaches the handler.
+	PropertyReply result;
+	bool fits = (request.data != nullptr);
+	bool ok   = fits && onProperty && onProperty(request, result);
+	if (request.type == M::PROP_NOTIFY) return;
+
+	// Data goes out in the encoding the request asked for.  Anything else must already be 7-bit.
+	bool mcoded7 = (request.fields.encoding != PE_Header::ENCODING_ASCII);
+	if      (!fits) result = PropertyReply{"{\"status\":413}", std::string()};
+	else if (!ok)   result = PropertyReply{"{\"status\":404}", std::string()};
+	else if (!Is7Bit(result.header) || (!mcoded7 && !Is7Bit(result.data)))
+	{
+		result = PropertyReply{"{\"status\":500}", std::string()};
+	}
+	else
+	{
+		if (result.header.empty())
+			result.header = mcoded7 ? "{\"status\":200,\"mutualEncoding\":\"Mcoded7\"}" : "{\"status\":200}";
+		if (mcoded7)
+		{
+			std::string encoded(Mcoded7_Size(result.data.size()), '\0');
+			encoded.resize(Mcoded7_Encode((const uint8_t*) result.data.data(), result.data.size(), (uint8_t*) &encoded[0]));
+			result.data.swap(encoded);
+		}
+	}
+
+	// Split the data to fit the peer's largest SysEx message;  the header goes in the first chunk.
+	uint32_t limit = MAX_MESSAGE;
+	{
+		std::lock_guard<std::mutex> lock(peerLock);
+		if (Peer *p = peer(request.source, false)) limit = std::min<uint32_t>(limit, p->maxSysExSize);
+	}
+	M::PropertyChunk chunk(uint8_t(request.type + 1), CI_CHANNEL_ALL, muid(), request.source);
+	chunk.request_id = request.requestId;
+
+	size_t overhead = chunk.size() + 2 + result.header.size();   // F0 and F7, with empty data
+	size_t capacity = (limit > overhead + 16) ? (limit - overhead) : 16;
+	size_t count    = std::max<size_t>(1, (result.data.size() + capacity - 1) / capacity);
+	if (count > 0x3FFF) return;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		size_t offset = i * capacity;
+		size_t length = std::min(capacity, result.data.size() - std::min(offset, result.data.size()));
+
+		chunk.header      = (i == 0) ? CI_Data<sysex::UInt14>((const uint8_t*) result.header.data(), uint32_t(result.header.size())) : CI_Data<sysex::UInt14>();
+		chunk.chunk_count = uint32_t(count);
+		chunk.chunk_index = uint32_t(i + 1);
+		chunk.data        = CI_Data<sysex::UInt14>((const uint8_t*) result.data.data() + offset, uint32_t(length));
+		send(chunk);
+	}
+}
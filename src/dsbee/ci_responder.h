@@ -0,0 +1,206 @@
+#pragma once
+
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <plaid_midi2/ci.h>
+#include <plaid_midi2/property_exchange.h>
+#include <plaid_midi2/sysex_assembler.h>
+
+#include "ring_buffer.h"
+
+
+namespace dsbee
+{
+	/*
+		Answers MIDI-CI:  discovery, protocol negotiation, profile inquiries and property exchange.
+
+			The audio thread only moves bytes:  push() queues incoming CI messages and drain()
+			collects replies, through lock-free queues.  Everything else runs on a worker thread,
+			which polls the queues and keeps the state:
+				- a table of peers (MUIDs) seen, with their identity and negotiated protocol
+				- retries for our discovery inquiry, and timeouts for unfinished negotiations
+				- property exchange requests being reassembled (by PE_Receiver, into space
+				  allocated up front), and replies being sent in chunks
+
+			Property requests go to onProperty, on the worker thread.
+	*/
+	class CI_Responder : private midi2::CI_Handler, private midi2::PE_Receiver
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+		using M     = midi2::CI_Message;
+
+		enum
+		{
+			MAX_MESSAGE  = 512,   // Largest CI message we send or accept, in bytes (our max SysEx size)
+			MAX_PEERS    = 32,
+			MAX_REQUESTS = 4,     // Property requests reassembled at once
+			MAX_PROPERTY = 16384, // Largest property data accepted, in bytes (decoded);  larger gets 413
+		};
+
+		struct Peer
+		{
+			midi2::MUID        muid;
+			midi2::CI_Identity identity;
+			uint8_t            capabilities = 0;
+			uint32_t           maxSysExSize = MAX_MESSAGE;
+			midi2::CI_Protocol protocol;                  // Negotiated protocol (MIDI 1.0 until then)
+			Clock::time_point  lastSeen;
+		};
+
+		struct PropertyRequest
+		{
+			uint8_t          type;       // CI_Message::PROP_* inquiry type
+			midi2::MUID      source;
+			uint8_t          requestId;
+			std::string      header;     // JSON
+			midi2::PE_Header fields;     // Parsed from the header
+			const uint8_t   *data;       // Decoded from Mcoded7 if the header says so;  valid during the call
+			size_t           length;
+		};
+		struct PropertyReply
+		{
+			std::string header;     // JSON;  {"status":200} if left empty
+			std::string data;       // Sent as Mcoded7 if the request's mutualEncoding asks for it
+		};
+
+		// Return false to answer with status 404.  A reply that can't be sent as 7-bit SysEx
+		//   (8-bit data without Mcoded7, or an 8-bit header) is answered with status 500.
+		using PropertyHandler = std::function<bool(const PropertyRequest&, PropertyReply&)>;
+
+	public:
+		CI_Responder(const midi2::CI_Identity &identity, PropertyHandler onProperty = nullptr,
+			size_t queueBytes = 16384, unsigned pollMilliseconds = 5);
+		~CI_Responder();
+
+		CI_Responder(const CI_Responder&) = delete;
+		CI_Responder &operator=(const CI_Responder&) = delete;
+
+		/*
+			Audio thread:  queue an incoming SysEx message, if it is MIDI-CI.
+				Returns false if it isn't, or the queue is full.
+		*/
+		bool push(const midi2::SysEx_Event &event);
+
+		/*
+			Audio thread:  pass queued replies to send(const uint8_t *dump, size_t length),
+				as MIDI 1.0 SysEx dumps (F0 ... F7), up to maxMessages of them.
+				Each dump is only valid during the call.  Returns the number sent.
+		*/
+		template<typename Send>
+		size_t drain(Send &&send, size_t maxMessages = size_t(-1));
+
+		/*
+			Our MUID.  It changes if another device claims it.
+		*/
+		midi2::MUID muid() const    {return midi2::MUID(ownMuid.load(std::memory_order_relaxed));}
+
+		/*
+			Peers seen so far.  Any thread.
+		*/
+		std::vector<Peer> peers() const;
+
+		/*
+			Profiles to report as enabled and disabled, and protocols we accept, best first.
+				Set these before messages arrive.
+		*/
+		std::vector<midi2::CI_ProfileId> enabledProfiles, disabledProfiles;
+		std::vector<midi2::CI_Protocol>  protocols = {midi2::CI_Protocol(midi2::UMP::Protocol::Midi_1_0())};
+
+	private:
+		// Worker thread
+		void run();
+		void service(Clock::time_point now);
+		void flush();
+		Peer *peer(midi2::MUID muid, bool create);
+		bool addressed(const M::Base &m) const;
+
+		template<typename Message>
+		void send(const Message &message);
+
+		void on_discovery       (const M::Discovery           &m) override;
+		void on_invalidate      (const M::InvalidateMUID      &m) override;
+		void on_protocol_init   (const M::ProtocolInit        &m) override;
+		void on_protocol_set    (const M::ProtocolSet         &m) override;
+		void on_protocol_test   (const M::ProtocolTest        &m) override;
+		void on_protocol_confirm(const M::ProtocolNegotiation &m) override;
+		void on_profile_inquiry (const M::Base                &m) override;
+		void on_property_caps   (const M::PropertyCaps        &m) override;
+		void on_property        (const M::PropertyChunk       &m) override;
+
+		void on_header  (const Chunk &chunk, const midi2::PE_Header &header) override;
+		void on_complete(const Chunk &chunk, const midi2::PE_Header &header, const uint8_t *data, size_t length) override;
+
+		void reply(const PropertyRequest &request);
+
+	private:
+		// Records in the queues are a 32-bit length followed by that many bytes.
+		static bool WriteRecord(RingBuffer<uint8_t> &queue, const uint8_t *bytes, uint32_t length, uint8_t prefix = 0, uint8_t suffix = 0);
+		static bool ReadRecord (RingBuffer<uint8_t> &queue, std::vector<uint8_t> &record);
+
+		midi2::CI_Identity identity;
+		PropertyHandler    onProperty;
+		unsigned           pollMilliseconds;
+
+		RingBuffer<uint8_t>  inbound, outbound;
+		std::vector<uint8_t> drainScratch;   // Audio thread
+		std::vector<uint8_t> workScratch;    // Worker thread
+
+		std::atomic<uint32_t> ownMuid;
+		std::atomic<bool>     stopping {false};
+
+		// Worker state
+		mutable std::mutex                  peerLock;
+		std::vector<Peer>                   peerTable;
+		std::deque<std::vector<uint8_t>>    outbox;      // Replies waiting for queue space
+
+		struct Negotiation
+		{
+			midi2::MUID        muid;
+			midi2::CI_Protocol previous;   // Restored if the new protocol isn't confirmed
+			Clock::time_point  deadline;
+		};
+		std::vector<Negotiation> negotiations;
+
+		// Requests PE_Receiver is reassembling:  their JSON headers, and when to give up on them.
+		struct PartialRequest
+		{
+			bool              active = false;
+			midi2::MUID       source;
+			uint8_t           requestId = 0;
+			std::string       header;
+			Clock::time_point deadline;
+		};
+		PartialRequest partials[MAX_REQUESTS];
+
+		PartialRequest *partial(const Chunk &chunk, bool start);
+
+		unsigned          discoveryTries = 0;
+		bool              discovered     = false;
+		Clock::time_point discoveryTime;
+
+		std::thread worker;
+	};
+
+
+	template<typename Send>
+	size_t CI_Responder::drain(Send &&send, size_t maxMessages)
+	{
+		size_t sent = 0;
+		while (sent < maxMessages && ReadRecord(outbound, drainScratch))
+		{
+			send(static_cast<const uint8_t*>(drainScratch.data()), drainScratch.size());
+			++sent;
+		}
+		return sent;
+	}
+}
@@ -0,0 +1,398 @@
+#pragma once
+
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "dsbee.h"
+
+
+namespace dsbee
+{
+	/*
+		A delay line with fractional (interpolated) reads.
+
+			Storage is a power of two, written twice ("mirrored") so that any run of samples
+			up to the line's length is contiguous in memory.  Block reads and interpolation
+			never need to check for wrap-around.
+
+			Delays are counted back from the newest sample (delay 0).
+			reset() allocates; nothing else does.
+	*/
+	class DelayLine
+	{
+	public:
+		/*
+			Allocate for delays of up to maxDelay samples, read after writes of up to maxBlock samples.
+				Clears the line.
+		*/
+		void reset(index_t maxDelay, index_t maxBlock = 64)
+		{
+			size_t size = 1;
+			while (size < size_t(maxDelay + maxBlock + 4)) size <<= 1;
+
+			data.assign(2 * size, 0.f);
+			mask     = size - 1;
+			position = 0;
+		}
+
+		size_t length() const    {return mask + 1;}
+
+		// Write one sample or a block of samples.
+		void push(float x)
+		{
+			size_t p = position++ & mask;
+			data[p] = data[p + mask + 1] = x;
+		}
+		void write(const float *x, index_t count)
+		{
+			float *a = data.data(), *b = a + mask + 1;
+			for (index_t i = 0; i < count; ++i)
+			{
+				size_t p = (position + i) & mask;
+				a[p] = b[p] = x[i];
+			}
+			position += count;
+		}
+
+		/*
+			After writing a block of count samples:  a pointer p such that p[i]
+				is the sample delay samples before sample i of that block.
+		*/
+		const float *delayed(index_t delay, index_t count) const
+		{
+			return data.data() + ((position - count - delay) & mask);
+		}
+
+		// Read at an integer delay.
+		float at(index_t delay) const
+		{
+			return data[(position - 1 - delay) & mask];
+		}
+
+		// Linear interpolation.  delay >= 0.
+		float linear(float delay) const
+		{
+			index_t k = index_t(delay);
+			float   f = delay - float(k);
+			const float *p = data.data() + ((position - 2 - k) & mask); // p[0] is delay k+1, p[1] is delay k
+			return p[1] + f * (p[0] - p[1]);
+		}
+
+		// Third-order Lagrange interpolation:  smoother, for modulated delays.  delay >= 1.
+		float lagrange(float delay) const
+		{
+			index_t k = index_t(delay);
+			float   f = delay - float(k);
+			const float *p = data.data() + ((position - 3 - k) & mask); // p[3] is delay k-1 ... p[0] is delay k+2
+
+			float fm1 = f - 1.f, fm2 = f - 2.f, fp1 = f + 1.f;
+			return p[3] * (-f * fm1 * fm2 / 6.f)
+			     + p[2] * (fp1 * fm1 * fm2 * .5f)
+			     + p[1] * (-fp1 * f * fm2 * .5f)
+			     + p[0] * (fp1 * f * fm1 / 6.f);
+		}
+
+		/*
+			First-order allpass (Thiran) interpolation:  flat magnitude, for slowly-changing delays.
+				Each reader keeps its own state.  delay >= .5.
+		*/
+		struct Allpass
+		{
+			float last = 0.f;
+
+			float read(const DelayLine &line, float delay)
+			{
+				index_t k = index_t(delay);
+				float   f = delay - float(k);
+				if (f < .5f && k > 0) {--k; f += 1.f;}
+
+				float eta = (1.f - f) / (1.f + f);
+				const float *p = line.data.data() + ((line.position - 2 - k) & line.mask);
+				return last = eta * (p[1] - last) + p[0];
+			}
+		};
+
+	private:
+		std::vector<float> data;
+		size_t             mask = 0, position = 0;
+	};
+
+
+	/*
+		Base class for delay effects:  a delay line per channel, processed in blocks.
+	*/
+	class DelayEffect : public Processor
+	{
+	public:
+		enum
+		{
+			MAX_CHANNELS = 8,  // Channels beyond this are silenced
+			BLOCK        = 64,
+		};
+
+		void start(AudioInfo info) override
+		{
+			sampleRate = info.sampleRate;
+
+			index_t maxDelay = maxDelaySamples();
+			for (DelayLine &line : lines) line.reset(maxDelay, BLOCK);
+			quietSamples = 0;
+
+			reset();
+		}
+
+		// Stereo out; mono input is spread to both sides.
+		index_t inputChannels () const override    {return 2;}
+		index_t outputChannels() const override    {return 2;}
+
+		bool isIdle() const override    {index_t tail = tailLength(); return tail != TAIL_UNKNOWN && quietSamples >= tail;}
+
+		void process(const float *input, float *output, index_t count) override
+		{
+			Buses<float> buses = {&input, &output, 1, 1, count, false};
+			run(buses);
+		}
+		void process(const double *input, double *output, index_t count) override
+		{
+			Buses<double> buses = {&input, &output, 1, 1, count, false};
+			run(buses);
+		}
+
+		void process(const Buses<float>  &buses) override    {run(buses);}
+		void process(const Buses<double> &buses) override    {run(buses);}
+
+	protected:
+		// Subclasses:  the longest delay used, in samples, given sampleRate.
+		virtual index_t maxDelaySamples() const = 0;
+
+		// Subclasses:  process one channel's block of up to BLOCK samples.  May be in-place.
+		virtual void processChannel(index_t channel, const float *input, float *output, index_t count) = 0;
+
+		// Subclasses:  called after each block, to advance modulation.
+		virtual void advance(index_t count) {}
+
+		// Subclasses:  reset modulation state.  Called from start().
+		virtual void reset() {}
+
+		index_t Samples(float ms) const    {return index_t(ms * .001f * sampleRate + .5f);}
+
+	protected:
+		float     sampleRate = 48000.f;
+		DelayLine lines[MAX_CHANNELS];
+
+	private:
+		template<typename Sample>
+		void run(const Buses<Sample> &buses)
+		{
+			index_t channels = std::min<index_t>(buses.outputCount, MAX_CHANNELS);
+
+			for (index_t c = channels; c < buses.outputCount; ++c)
+				std::fill(buses.outputs[c], buses.outputs[c] + buses.count, Sample(0));
+
+			bool silent = true;
+			for (index_t done = 0; done < buses.count; done += BLOCK)
+			{
+				index_t n = std::min<index_t>(BLOCK, buses.count - done);
+				float block[BLOCK];
+
+				for (index_t c = 0; c < channels; ++c)
+				{
+					// Outputs beyond the inputs reuse the last input channel.
+					const Sample *x = (buses.inputCount ? buses.inputs[std::min(c, buses.inputCount - 1)] + done : nullptr);
+					for (index_t i = 0; i < n; ++i) block[i] = (x ? float(x[i]) : 0.f);
+					if (silent && !buses.silentInput) silent = IsSilent(block, n);
+
+					processChannel(c, block, block, n);
+
+					Sample *y = buses.outputs[c] + done;
+					for (index_t i = 0; i < n; ++i) y[i] = Sample(block[i]);
+				}
+				advance(n);
+			}
+
+			quietSamples = silent ? std::min<index_t>(quietSamples + buses.count, 0x7FFFFFFF) : 0;
+		}
+
+	private:
+		index_t quietSamples = 0;
+	};
+
+
+	/*
+		A low-frequency oscillator, evaluated once per block and interpolated across it.
+			Cheap enough for many modulated taps.
+	*/
+	struct BlockLFO
+	{
+		float phase = 0.f; // 0 to 1
+
+		// Fill out[0..count) with sin at phase + offset, ramping to where the phase will be after count samples.
+		void render(float *out, index_t count, float offset, float increment) const
+		{
+			const float TWO_PI = 6.2831853f;
+			float a = std::sin(TWO_PI * (phase + offset));
+			float b = std::sin(TWO_PI * (phase + offset + increment * float(count)));
+			float step = (b - a) / float(count);
+			for (index_t i = 0; i < count; ++i) out[i] = a + step * float(i);
+		}
+
+		void advance(index_t count, float increment)
+		{
+			phase += increment * float(count);
+			phase -= std::floor(phase);
+		}
+	};
+
+
+	/*
+		Chorus:  several copies of the signal, each delayed by a slowly-moving amount.
+			Voices are spread in phase across channels for a wide stereo image.
+	*/
+	class Chorus : public DelayEffect
+	{
+	public:
+		enum { MAX_VOICES = 8 };
+
+		index_t voices  = 3;
+		float   delayMs = 15.f;
+		float   depthMs = 4.f;   // Modulation, either side of delayMs
+		float   rateHz  = .8f;
+		float   mix     = .5f;
+
+		index_t tailLength() const override    {return maxDelaySamples();}
+
+	protected:
+		index_t maxDelaySamples() const override    {return Samples(delayMs + depthMs) + 4;}
+
+		void reset() override    {lfo.phase = 0.f;}
+
+		void processChannel(index_t channel, const float *input, float *output, index_t count) override
+		{
+			DelayLine &line = lines[channel];
+			line.write(input, count);
+
+			index_t voiceCount = std::min<index_t>(std::max<index_t>(voices, 1), MAX_VOICES);
+			float increment = rateHz / sampleRate, center = delayMs * .001f * sampleRate, depth = depthMs * .001f * sampleRate;
+			float wet[BLOCK] = {}, mod[BLOCK];
+
+			for (index_t v = 0; v < voiceCount; ++v)
+			{
+				lfo.render(mod, count, float(v) / float(voiceCount) + .25f * float(channel), increment);
+				for (index_t i = 0; i < count; ++i)
+				{
+					float delay = std::max(1.f, center + depth * mod[i]) + float(count - 1 - i);
+					wet[i] += line.lagrange(delay);
+				}
+			}
+
+			float dryGain = 1.f - mix, wetGain = mix / float(voiceCount);
+			for (index_t i = 0; i < count; ++i) output[i] = dryGain * input[i] + wetGain * wet[i];
+		}
+
+		void advance(index_t count) override    {lfo.advance(count, rateHz / sampleRate);}
+
+	private:
+		BlockLFO lfo;
+	};
+
+
+	/*
+		Flanger:  a short, swept delay with feedback, mixed with the dry signal.
+	*/
+	class Flanger : public DelayEffect
+	{
+	public:
+		float delayMs  = 2.5f;
+		float depthMs  = 2.f;
+		float rateHz   = .25f;
+		float feedback = .5f;  // -1 to 1, exclusive
+		float mix      = .5f;
+
+		index_t tailLength() const override
+		{
+			// Until feedback decays by 120 dB.
+			float fb = std::min(std::abs(feedback), .999f);
+			float trips = (fb > 1e-3f) ? std::log(1e-6f) / std::log(fb) : 1.f;
+			return index_t(trips * float(maxDelaySamples()));
+		}
+
+	protected:
+		index_t maxDelaySamples() const override    {return Samples(delayMs + depthMs) + 4;}
+
+		void reset() override
+		{
+			lfo.phase = 0.f;
+			for (float &f : feedbackSample) f = 0.f;
+		}
+
+		void processChannel(index_t channel, const float *input, float *output, index_t count) override
+		{
+			// Feedback paths can be shorter than a block, so this runs sample by sample.
+			DelayLine &line = lines[channel];
+			float increment = rateHz / sampleRate, center = delayMs * .001f * sampleRate, depth = depthMs * .001f * sampleRate;
+			float fb = std::max(-.99f, std::min(.99f, feedback)), dryGain = 1.f - mix;
+			float mod[BLOCK];
+
+			lfo.render(mod, count, .25f * float(channel), increment);
+
+			float last = feedbackSample[channel];
+			for (index_t i = 0; i < count; ++i)
+			{
+				float x = input[i];
+				line.push(x + fb * last);
+				last = line.linear(std::max(1.f, center + depth * mod[i]));
+				output[i] = dryGain * x + mix * last;
+			}
+			feedbackSample[channel] = last;
+		}
+
+		void advance(index_t count) override    {lfo.advance(count, rateHz / sampleRate);}
+
+	private:
+		BlockLFO lfo;
+		float    feedbackSample[MAX_CHANNELS] = {};
+	};
+
+
+	/*
+		Multi-tap delay:  a set of echoes at fixed times.
+			Each echo is a contiguous block read, so many taps stay cheap.
+	*/
+	class MultiTap : public DelayEffect
+	{
+	public:
+		struct Echo
+		{
+			float delayMs;
+			float gain;
+		};
+
+		std::vector<Echo> echoes = {{125.f, .5f}, {250.f, .35f}, {375.f, .25f}};
+		float             dry    = 1.f;
+
+		index_t tailLength() const override    {return maxDelaySamples();}
+
+	protected:
+		index_t maxDelaySamples() const override
+		{
+			index_t longest = 0;
+			for (const Echo &echo : echoes) longest = std::max(longest, Samples(echo.delayMs));
+			return longest;
+		}
+
+		void processChannel(index_t channel, const float *input, float *output, index_t count) override
+		{
+			DelayLine &line = lines[channel];
+			line.write(input, count);
+
+			for (index_t i = 0; i < count; ++i) output[i] = dry * input[i];
+			for (const Echo &echo : echoes)
+			{
+				const float *delayed = line.delayed(Samples(echo.delayMs), count);
+				for (index_t i = 0; i < count; ++i) output[i] += echo.gain * delayed[i];
+			}
+		}
+	};
+}
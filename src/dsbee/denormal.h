@@ -0,0 +1,76 @@
+#pragma once
+
+
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__) || defined(__x86_64__)
+	#include <xmmintrin.h>
+	#define DSBEE_FPU_SSE 1
+#elif defined(__aarch64__) && !defined(_MSC_VER)
+	#define DSBEE_FPU_ARM64 1
+#endif
+
+/*
+	Set DSBEE_DENORMAL_DEBUG to count, per Chain stage, the blocks in which floating-point
+		underflow (denormal results) occurred.  On by default in debug builds.
+*/
+#ifndef DSBEE_DENORMAL_DEBUG
+	#if defined(_DEBUG)
+		#define DSBEE_DENORMAL_DEBUG 1
+	#else
+		#define DSBEE_DENORMAL_DEBUG 0
+	#endif
+#endif
+
+
+namespace dsbee
+{
+	/*
+		Denormal (subnormal) numbers appear when filters and feedback loops decay toward zero.
+			Many CPUs process them 10-100x slower than normal numbers.
+
+		While a DenormalScope exists, the current thread flushes denormals to zero
+			(FTZ and DAZ on x86, FZ on ARM64).  The previous mode is restored afterwards,
+			so it is safe to use in code called by any host.
+	*/
+	class DenormalScope
+	{
+	public:
+#if DSBEE_FPU_SSE
+		DenormalScope()     : saved(_mm_getcsr()) {_mm_setcsr(saved | FTZ | DAZ);}
+		~DenormalScope()    {_mm_setcsr(saved);}
+
+	private:
+		enum : unsigned { DAZ = 0x0040, FTZ = 0x8000 };
+		unsigned saved;
+#elif DSBEE_FPU_ARM64
+		DenormalScope()     {__asm__ __volatile__("mrs %0, fpcr" : "=r"(saved)); uint64_t fz = saved | FZ; __asm__ __volatile__("msr fpcr, %0" : : "r"(fz));}
+		~DenormalScope()    {__asm__ __volatile__("msr fpcr, %0" : : "r"(saved));}
+
+	private:
+		enum : uint64_t { FZ = uint64_t(1) << 24 };
+		uint64_t saved;
+#else
+		DenormalScope() {}
+#endif
+
+		DenormalScope(const DenormalScope&) = delete;
+		DenormalScope &operator=(const DenormalScope&) = delete;
+	};
+
+	/*
+		Underflow detection, for finding processors that produce denormals.
+			The CPU's sticky underflow flag is set even when denormals are flushed to zero.
+			ClearUnderflow resets it; Underflowed checks whether it's been set since.
+	*/
+#if DSBEE_FPU_SSE
+	inline void ClearUnderflow()    {_mm_setcsr(_mm_getcsr() & ~unsigned(_MM_EXCEPT_UNDERFLOW));}
+	inline bool Underflowed()       {return (_mm_getcsr() & _MM_EXCEPT_UNDERFLOW) != 0;}
+#elif DSBEE_FPU_ARM64
+	inline void ClearUnderflow()    {uint64_t s; __asm__ __volatile__("mrs %0, fpsr" : "=r"(s)); s &= ~uint64_t(0x08); __asm__ __volatile__("msr fpsr, %0" : : "r"(s));}
+	inline bool Underflowed()       {uint64_t s; __asm__ __volatile__("mrs %0, fpsr" : "=r"(s)); return (s & 0x08) != 0;}
+#else
+	inline void ClearUnderflow()    {}
+	inline bool Underflowed()       {return false;}
+#endif
+}
@@ -1,10 +1,18 @@
 #pragma once
 
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
+#include <vector>
 
 #include <plaid_midi2/midi2.h>
+#include <plaid_midi2/sysex_assembler.h>
+
+#include "denormal.h"
 
 
 namespace dsbee
@@ -64,19 +72,228 @@ namespace dsbee
 		float sampleRate;
 	};
 
+	/*
+		Samples quieter than this (about -120 dB) count as silence.
+	*/
+	static const float SILENCE_THRESHOLD = 1e-6f;
+
+	/*
+		Check whether a buffer is silent.
+	*/
+	template<typename Sample>
+	bool IsSilent(const Sample *samples, index_t count)
+	{
+		for (index_t i = 0; i < count; ++i)
+		{
+			if (samples[i] > SILENCE_THRESHOLD || samples[i] < -SILENCE_THRESHOLD) return false;
+		}
+		return true;
+	}
+
+	/*
+		Multichannel audio buffers, handed to a processor in a single call.
+			The processor should fill every output channel.
+			Inputs and outputs may refer to the same memory.
+			silentInput is set when every input channel is known to be silent.
+	*/
+	template<typename Sample>
+	struct Buses
+	{
+		const Sample *const *inputs;
+		Sample       *const *outputs;
+		index_t              inputCount;  // Number of input channels
+		index_t              outputCount; // Number of output channels
+		index_t              count;       // Samples per channel
+		bool                 silentInput; // All inputs are silent
+	};
+
+	/*
+		Writes binary state, used for saving processors (presets, sessions, VST chunks).
+			Writing past the end of the buffer fails, but size() still counts every byte,
+			so a writer with no buffer can be used to measure how much space is needed.
+	*/
+	class StateWriter
+	{
+	public:
+		uint8_t *buffer;
+		size_t   capacity;
+		size_t   length = 0;
+
+	public:
+		StateWriter(uint8_t *_buffer = nullptr, size_t _capacity = 0)    : buffer(_buffer), capacity(_capacity) {}
+
+		// Number of bytes written (or which would have been written).
+		size_t size()     const    {return length;}
+		bool   overflow() const    {return length > capacity;}
+
+		// Write raw bytes.
+		void writeBytes(const void *data, size_t n)
+		{
+			if (length + n <= capacity) std::memcpy(buffer + length, data, n);
+			length += n;
+		}
+
+		// Write a plain value.
+		template<typename T>
+		void write(const T &value)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "state values must be plain data");
+			writeBytes(&value, sizeof(T));
+		}
+
+		// Overwrite a value written earlier at the given offset (such as a size prefix).
+		template<typename T>
+		void patch(size_t offset, const T &value)
+		{
+			if (offset + sizeof(T) <= capacity) std::memcpy(buffer + offset, &value, sizeof(T));
+		}
+	};
+
+	/*
+		Reads binary state written by StateWriter.
+			Reads never allocate; a failed read leaves the reader in a failed state.
+	*/
+	class StateReader
+	{
+	public:
+		const uint8_t *pos, *end;
+		bool           failed = false;
+
+	public:
+		StateReader(const uint8_t *data, size_t size)    : pos(data), end(data + size) {}
+
+		size_t remaining() const    {return end - pos;}
+
+		// Read raw bytes, returning a pointer into the source (or nullptr).
+		const uint8_t *readBytes(size_t n)
+		{
+			if (failed || remaining() < n) {failed = true; return nullptr;}
+			const uint8_t *p = pos; pos += n;
+			return p;
+		}
+
+		// Read a plain value.
+		template<typename T>
+		bool read(T &value)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "state values must be plain data");
+			if (const uint8_t *p = readBytes(sizeof(T))) {std::memcpy(&value, p, sizeof(T)); return true;}
+			return false;
+		}
+	};
+
 	/*
 		The base class for DSBee processors.
 	*/
 	class Processor
 	{
 	public:
-		// virtual void process(Buses buses); // PLANNED
+		virtual ~Processor() {}
 
 		virtual void start(AudioInfo info) = 0;
 
 		virtual void process(const float *input, float *output, index_t count) = 0;
 
+		/*
+			Double-precision processing, used when the host mixes in 64-bit.
+				Override this to run your inner loop in double.
+				By default it runs in "mixed mode", converting small blocks on the stack
+				and calling the float version, so float-only processors keep working.
+		*/
+		virtual void process(const double *input, double *output, index_t count)
+		{
+			enum { MIXED_BLOCK = 64 };
+			float in[MIXED_BLOCK], out[MIXED_BLOCK];
+
+			for (index_t done = 0; done < count; done += MIXED_BLOCK)
+			{
+				index_t n = std::min<index_t>(MIXED_BLOCK, count - done);
+				for (index_t i = 0; i < n; ++i) in[i] = float(input[done+i]);
+				process(in, out, n);
+				for (index_t i = 0; i < n; ++i) output[done+i] = out[i];
+			}
+		}
+
+		/*
+			Channel layout.  Processors are mono unless they override these,
+				along with the Buses versions of process.
+		*/
+		virtual index_t inputChannels () const    {return 1;}
+		virtual index_t outputChannels() const    {return 1;}
+
+		/*
+			Multichannel processing.
+				By default, the first input channel goes through the mono method
+				and the result is copied to every output channel.
+		*/
+		virtual void process(const Buses<float>  &buses)    {processFirstChannel(buses);}
+		virtual void process(const Buses<double> &buses)    {processFirstChannel(buses);}
+
 		virtual void midiIn(const UMP &event)    {}
+
+		/*
+			MIDI input placed in time:  the event takes effect offset samples into the next block.
+				Processors that render sample-accurately should override this;  by default
+				the offset is ignored.
+		*/
+		virtual void midiInAt(const UMP &event, index_t offset)    {midiIn(event);}
+
+		/*
+			System Exclusive input, already reassembled.
+				The message bytes are only valid during the call.
+		*/
+		virtual void sysExIn(const SysEx_Event &event)    {}
+
+		/*
+			Latency, in samples, between input and output.
+				Processors that look ahead should report it here.
+		*/
+		virtual index_t latency() const    {return 0;}
+
+		/*
+			Silence.  A processor is idle when its internal state has decayed to silence,
+				so that silent input would produce silent output.  Idle processors
+				can be skipped on silent input; the default is to never be idle.
+			The tail is how long output may continue after input falls silent, in samples.
+				TAIL_NONE means output stops with the input; synths and other processors
+				that can sound indefinitely should use TAIL_UNKNOWN (the default).
+		*/
+		enum : index_t { TAIL_NONE = 0, TAIL_UNKNOWN = -1 };
+
+		virtual bool    isIdle    () const    {return false;}
+		virtual index_t tailLength() const    {return TAIL_UNKNOWN;}
+
+		/*
+			Called on the audio thread when the host (soft-)bypasses this processor,
+				and again when bypass ends.  process() isn't called while bypassed.
+		*/
+		virtual void setBypass(bool bypass)    {}
+
+		/*
+			Save and restore internal state, for presets and sessions.
+				loadState is called from the audio thread between blocks, so it must not allocate.
+				saveState may be called from another thread while audio is running.
+		*/
+		virtual void saveState(StateWriter &writer) const    {}
+		virtual bool loadState(StateReader &reader)          {return true;}
+
+	protected:
+		template<typename Sample>
+		void processFirstChannel(const Buses<Sample> &buses)
+		{
+			if (buses.outputCount < 1) return;
+
+			// Without any input, run in-place on silence.
+			Sample *output = buses.outputs[0];
+			if (buses.inputCount < 1) std::fill(output, output + buses.count, Sample(0));
+
+			process((buses.inputCount ? buses.inputs[0] : output), output, buses.count);
+
+			for (index_t c = 1; c < buses.outputCount; ++c)
+			{
+				std::copy(output, output + buses.count, buses.outputs[c]);
+			}
+		}
 	};
 
 	Processor *GetProcessor();
@@ -93,7 +310,14 @@ namespace dsbee
 		*/
 		virtual float makeSample() = 0;
 
-		void process(const float *input, float *output, index_t count) override
+		using Processor::process;
+
+		void process(const float  *input, float  *output, index_t count) override    {generate(output, count);}
+		void process(const double *input, double *output, index_t count) override    {generate(output, count);}
+
+	private:
+		template<typename Sample>
+		void generate(Sample *output, index_t count)
 		{
 			for (index_t i = 0; i < count; ++i)
 			{
@@ -113,15 +337,39 @@ namespace dsbee
 		*/
 		virtual float processSample(const float input) = 0;
 
-		void process(const float *input, float *output, index_t count) override
+		using Processor::process;
+
+		void process(const float  *input, float  *output, index_t count) override    {transform(input, output, count);}
+		void process(const double *input, double *output, index_t count) override    {transform(input, output, count);}
+
+	private:
+		template<typename Sample>
+		void transform(const Sample *input, Sample *output, index_t count)
 		{
 			for (index_t i = 0; i < count; ++i)
 			{
-				output[i] = processSample(input[i]);
+				output[i] = processSample(float(input[i]));
 			}
 		}
 	};
 
+	/*
+		Temporary channel buffers for multichannel processing.
+	*/
+	template<typename Sample>
+	struct BusTemporary
+	{
+		std::vector<Sample>  samples;
+		std::vector<Sample*> channels;
+
+		void prepare(index_t channelCount, index_t count)
+		{
+			samples .resize(channelCount * count);
+			channels.resize(channelCount);
+			for (index_t c = 0; c < channelCount; ++c) channels[c] = samples.data() + c*count;
+		}
+	};
+
 	/*
 		A chain of processors.
 	*/
@@ -130,10 +378,17 @@ namespace dsbee
 	private:
 		std::vector<Processor*> processors;
 		std::vector<float>      temporary[2];
+		std::vector<double>     temporary64[2];
 
-	public:
-		// virtual void process(Buses buses); // PLANNED
+		BusTemporary<float>  busTemporary[2];
+		BusTemporary<double> busTemporary64[2];
 
+#if DSBEE_DENORMAL_DEBUG
+		// Per stage: the number of blocks in which the stage produced denormals.
+		std::vector<uint32_t> denormals;
+#endif
+
+	public:
 		// Zero-length chain
 		Chain() {}
 
@@ -141,6 +396,22 @@ namespace dsbee
 		void add(Processor *processor)
 		{
 			processors.push_back(processor);
+#if DSBEE_DENORMAL_DEBUG
+			denormals.push_back(0);
+#endif
+		}
+
+		/*
+			How many blocks has a stage produced denormals in?
+				Always 0 unless DSBEE_DENORMAL_DEBUG is enabled.
+		*/
+		uint32_t denormalCount(size_t stage) const
+		{
+#if DSBEE_DENORMAL_DEBUG
+			return (stage < denormals.size()) ? denormals[stage] : 0;
+#else
+			return 0;
+#endif
 		}
 
 		// Construct from an array
@@ -168,7 +439,29 @@ namespace dsbee
 			}
 		}
 
-		void process(const float *input, float *output, index_t count) override
+		// The chain is as wide as its widest stage.
+		index_t inputChannels() const override
+		{
+			index_t channels = 1;
+			for (Processor *processor : processors) channels = std::max(channels, processor->inputChannels());
+			return channels;
+		}
+		index_t outputChannels() const override
+		{
+			index_t channels = 1;
+			for (Processor *processor : processors) channels = std::max(channels, processor->outputChannels());
+			return channels;
+		}
+
+		void process(const float  *input, float  *output, index_t count) override    {runStages(input, output, count, temporary);}
+		void process(const double *input, double *output, index_t count) override    {runStages(input, output, count, temporary64);}
+
+		void process(const Buses<float>  &buses) override    {runStages(buses, busTemporary);}
+		void process(const Buses<double> &buses) override    {runStages(buses, busTemporary64);}
+
+	private:
+		template<typename Sample>
+		void runStages(const Sample *input, Sample *output, index_t count, std::vector<Sample> (&temporary)[2])
 		{
 			// Make our temporary buffers the same size as the
 			temporary[0].resize(count);
@@ -178,7 +471,7 @@ namespace dsbee
 			if (!processors.size())
 			{
 				// A zero-length chain should just copy input to output.
-				for (size_t i = 0; i < count; ++i) output[i] = input[i];
+				for (index_t i = 0; i < count; ++i) output[i] = input[i];
 
 				return;
 			}
@@ -189,15 +482,84 @@ namespace dsbee
 				bool first = (i == 0), last = (i+1 == processors.size());
 
 				// Decide the input and output buffers for this step.
-				const float *stage_input  = (first ? input  : temporary[whichTemporary].data());
+				const Sample *stage_input  = (first ? input  : temporary[whichTemporary].data());
+				whichTemporary = !whichTemporary;
+				Sample       *stage_output = (last  ? output : temporary[whichTemporary].data());
+
+				// Run the sub-process.
+				runStage(i, stage_input, stage_output, count);
+			}
+		}
+
+		// Run one stage, watching for denormals in debug builds.
+		template<typename ... Args>
+		void runStage(size_t i, Args&& ... args)
+		{
+#if DSBEE_DENORMAL_DEBUG
+			ClearUnderflow();
+			processors[i]->process(args...);
+			if (Underflowed()) ++denormals[i];
+#else
+			processors[i]->process(args...);
+#endif
+		}
+
+		template<typename Sample>
+		void runStages(const Buses<Sample> &buses, BusTemporary<Sample> (&temporary)[2])
+		{
+			index_t count = buses.count;
+
+			if (!processors.size())
+			{
+				// A zero-length chain should just copy input to output.
+				for (index_t c = 0; c < buses.outputCount; ++c)
+				{
+					if (c < buses.inputCount) std::copy(buses.inputs[c], buses.inputs[c] + count, buses.outputs[c]);
+					else                      std::fill(buses.outputs[c], buses.outputs[c] + count, Sample(0));
+				}
+				return;
+			}
+
+			// Intermediate stages all run at the full width of the chain.
+			index_t width = std::max(inputChannels(), outputChannels());
+			temporary[0].prepare(width, count);
+			temporary[1].prepare(width, count);
+			bool whichTemporary = false;
+
+			Buses<Sample> stage = buses;
+
+			for (size_t i = 0; i < processors.size(); ++i)
+			{
+				// Last stage of processing?
+				bool first = (i == 0), last = (i+1 == processors.size());
+
+				// Decide the input and output buses for this step.
+				if (!first)
+				{
+					stage.inputs     = temporary[whichTemporary].channels.data();
+					stage.inputCount = width;
+				}
 				whichTemporary = !whichTemporary;
-				float       *stage_output = (last  ? output : temporary[whichTemporary].data());
+				stage.outputs     = (last ? buses.outputs     : temporary[whichTemporary].channels.data());
+				stage.outputCount = (last ? buses.outputCount : width);
+
+				if (stage.silentInput && processors[i]->isIdle())
+				{
+					// Skip idle stages on silent input; their output is silent too.
+					for (index_t c = 0; c < stage.outputCount; ++c)
+					{
+						std::fill(stage.outputs[c], stage.outputs[c] + count, Sample(0));
+					}
+					continue;
+				}
 
 				// Run the sub-process.
-				processors[i]->process(stage_input, stage_output, count);
+				runStage(i, stage);
+				stage.silentInput = false;
 			}
 		}
 
+	public:
 		void midiIn(const UMP &event) override
 		{
 			for (size_t i = 0; i < processors.size(); ++i)
@@ -205,5 +567,304 @@ namespace dsbee
 				processors[i]->midiIn(event);
 			}
 		}
+		void midiInAt(const UMP &event, index_t offset) override
+		{
+			for (size_t i = 0; i < processors.size(); ++i)
+			{
+				processors[i]->midiInAt(event, offset);
+			}
+		}
+		void sysExIn(const SysEx_Event &event) override
+		{
+			for (size_t i = 0; i < processors.size(); ++i)
+			{
+				processors[i]->sysExIn(event);
+			}
+		}
+
+		// Stages run in series, so their latency adds up.
+		index_t latency() const override
+		{
+			index_t total = 0;
+			for (Processor *processor : processors) total += processor->latency();
+			return total;
+		}
+
+		// The chain is idle when all its stages are, and its tail is the sum of theirs.
+		bool isIdle() const override
+		{
+			for (Processor *processor : processors) if (!processor->isIdle()) return false;
+			return true;
+		}
+		index_t tailLength() const override
+		{
+			index_t total = TAIL_NONE;
+			for (Processor *processor : processors)
+			{
+				index_t tail = processor->tailLength();
+				if (tail == TAIL_UNKNOWN) return TAIL_UNKNOWN;
+				total += tail;
+			}
+			return total;
+		}
+
+		void setBypass(bool bypass) override
+		{
+			for (Processor *processor : processors) processor->setBypass(bypass);
+		}
+
+		void saveState(StateWriter &writer) const override
+		{
+			// Each stage's state is prefixed with its size, so stages can be skipped on load.
+			writer.write(uint32_t(processors.size()));
+			for (Processor *processor : processors)
+			{
+				size_t sizeAt = writer.size();
+				writer.write(uint32_t(0));
+				processor->saveState(writer);
+				writer.patch(sizeAt, uint32_t(writer.size() - sizeAt - sizeof(uint32_t)));
+			}
+		}
+
+		bool loadState(StateReader &reader) override
+		{
+			uint32_t stageCount = 0, stageSize = 0;
+			if (!reader.read(stageCount)) return false;
+
+			bool ok = true;
+			for (uint32_t i = 0; i < stageCount; ++i)
+			{
+				const uint8_t *stageBytes = (reader.read(stageSize) ? reader.readBytes(stageSize) : nullptr);
+				if (!stageBytes) return false;
+
+				// State for stages we no longer have is ignored.
+				if (i < processors.size())
+				{
+					StateReader stage(stageBytes, stageSize);
+					ok &= processors[i]->loadState(stage);
+				}
+			}
+			return ok;
+		}
+	};
+
+
+	/*
+		Processors side by side:  each branch gets the same input, and their outputs are mixed.
+			Use an empty Chain as a branch for a dry path.
+
+		Branches may have different latencies.  Each branch's output is delayed
+			to line up with the slowest one, and the mix reports that latency.
+	*/
+	class Parallel : public Processor
+	{
+	public:
+		enum
+		{
+			MAX_CHANNELS = 8,  // Channels delayed for alignment;  any beyond this are silenced
+		};
+
+	private:
+		struct Branch
+		{
+			Processor          *processor;
+			float               gain;
+			index_t             delay;   // Alignment delay, in samples
+			std::vector<double> history; // delay samples for each of MAX_CHANNELS
+			index_t             cursor;
+		};
+
+		std::vector<Branch>  branches;
+		index_t              maxLatency = 0;
+		index_t              quiet      = 0; // Samples since anything was audible
+
+		BusTemporary<float>  inputCopy,   branchOutput;
+		BusTemporary<double> inputCopy64, branchOutput64;
+
+	public:
+		Parallel() {}
+
+		~Parallel()
+		{
+			for (Branch &branch : branches) delete branch.processor;
+		}
+
+		// Add a branch, mixed in at the given gain.
+		void add(Processor *processor, float gain = 1.f)
+		{
+			branches.push_back(Branch{processor, gain, 0, {}, 0});
+		}
+
+		void start(AudioInfo info) override
+		{
+			for (Branch &branch : branches) branch.processor->start(info);
+
+			// Latency may depend on the sample rate, so alignment is worked out here.
+			maxLatency = 0;
+			for (Branch &branch : branches) maxLatency = std::max(maxLatency, branch.processor->latency());
+
+			// The bus may be wider than outputChannels() at run time, so every channel gets a delay line.
+			for (Branch &branch : branches)
+			{
+				branch.delay  = maxLatency - branch.processor->latency();
+				branch.cursor = 0;
+				branch.history.assign(MAX_CHANNELS * branch.delay, 0.0);
+			}
+			quiet = 0;
+		}
+
+		index_t inputChannels() const override
+		{
+			index_t channels = 1;
+			for (const Branch &branch : branches) channels = std::max(channels, branch.processor->inputChannels());
+			return channels;
+		}
+		index_t outputChannels() const override
+		{
+			index_t channels = 1;
+			for (const Branch &branch : branches) channels = std::max(channels, branch.processor->outputChannels());
+			return channels;
+		}
+
+		void process(const float *input, float *output, index_t count) override
+		{
+			Buses<float> buses = {&input, &output, 1, 1, count, false};
+			mix(buses, inputCopy, branchOutput);
+		}
+		void process(const double *input, double *output, index_t count) override
+		{
+			Buses<double> buses = {&input, &output, 1, 1, count, false};
+			mix(buses, inputCopy64, branchOutput64);
+		}
+
+		void process(const Buses<float>  &buses) override    {mix(buses, inputCopy,   branchOutput);}
+		void process(const Buses<double> &buses) override    {mix(buses, inputCopy64, branchOutput64);}
+
+		void midiIn(const UMP &event) override
+		{
+			for (Branch &branch : branches) branch.processor->midiIn(event);
+		}
+		void midiInAt(const UMP &event, index_t offset) override
+		{
+			for (Branch &branch : branches) branch.processor->midiInAt(event, offset);
+		}
+		void sysExIn(const SysEx_Event &event) override
+		{
+			for (Branch &branch : branches) branch.processor->sysExIn(event);
+		}
+
+		index_t latency() const override    {return maxLatency;}
+
+		// Idle once every branch is idle and the alignment delays have emptied.
+		bool isIdle() const override
+		{
+			if (quiet < maxLatency) return false;
+			for (const Branch &branch : branches) if (!branch.processor->isIdle()) return false;
+			return true;
+		}
+		index_t tailLength() const override
+		{
+			index_t longest = TAIL_NONE;
+			for (const Branch &branch : branches)
+			{
+				index_t tail = branch.processor->tailLength();
+				if (tail == TAIL_UNKNOWN) return TAIL_UNKNOWN;
+				longest = std::max(longest, tail);
+			}
+			return longest;
+		}
+
+		void setBypass(bool bypass) override
+		{
+			for (Branch &branch : branches) branch.processor->setBypass(bypass);
+		}
+
+		void saveState(StateWriter &writer) const override
+		{
+			// Each branch's state is prefixed with its size, as in Chain.
+			writer.write(uint32_t(branches.size()));
+			for (const Branch &branch : branches)
+			{
+				size_t sizeAt = writer.size();
+				writer.write(uint32_t(0));
+				branch.processor->saveState(writer);
+				writer.patch(sizeAt, uint32_t(writer.size() - sizeAt - sizeof(uint32_t)));
+			}
+		}
+
+		bool loadState(StateReader &reader) override
+		{
+			uint32_t branchCount = 0, branchSize = 0;
+			if (!reader.read(branchCount)) return false;
+
+			bool ok = true;
+			for (uint32_t i = 0; i < branchCount; ++i)
+			{
+				const uint8_t *branchBytes = (reader.read(branchSize) ? reader.readBytes(branchSize) : nullptr);
+				if (!branchBytes) return false;
+
+				if (i < branches.size())
+				{
+					StateReader branch(branchBytes, branchSize);
+					ok &= branches[i].processor->loadState(branch);
+				}
+			}
+			return ok;
+		}
+
+	private:
+		template<typename Sample>
+		void mix(const Buses<Sample> &buses, BusTemporary<Sample> &input, BusTemporary<Sample> &output)
+		{
+			index_t count = buses.count;
+
+			// Keep a copy of the input, since the outputs may overwrite it.
+			input .prepare(buses.inputCount,  count);
+			output.prepare(buses.outputCount, count);
+			for (index_t c = 0; c < buses.inputCount; ++c)
+				std::copy(buses.inputs[c], buses.inputs[c] + count, input.channels[c]);
+			for (index_t c = 0; c < buses.outputCount; ++c)
+				std::fill(buses.outputs[c], buses.outputs[c] + count, Sample(0));
+
+			Buses<Sample> branchBuses = {input.channels.data(), output.channels.data(),
+				buses.inputCount, buses.outputCount, count, buses.silentInput};
+
+			bool audible = !buses.silentInput;
+			for (Branch &branch : branches)
+			{
+				if (buses.silentInput && branch.processor->isIdle() && quiet >= maxLatency)
+					continue;
+				audible |= !branch.processor->isIdle();
+
+				branch.processor->process(branchBuses);
+
+				index_t cursor   = branch.cursor;
+				index_t channels = branch.delay ? std::min<index_t>(buses.outputCount, MAX_CHANNELS) : buses.outputCount;
+				for (index_t c = 0; c < channels; ++c)
+				{
+					const Sample *from = output.channels[c];
+					Sample       *to   = buses.outputs[c];
+
+					if (!branch.delay)
+					{
+						for (index_t i = 0; i < count; ++i) to[i] += Sample(branch.gain * from[i]);
+						continue;
+					}
+
+					double *history = branch.history.data() + c * branch.delay;
+					cursor = branch.cursor;
+					for (index_t i = 0; i < count; ++i)
+					{
+						double delayed = history[cursor];
+						history[cursor] = double(from[i]);
+						if (++cursor >= branch.delay) cursor = 0;
+						to[i] += Sample(branch.gain * delayed);
+					}
+				}
+				branch.cursor = cursor;
+			}
+
+			quiet = audible ? 0 : std::min(quiet + count, maxLatency);
+		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,445 @@
+#pragma once
+
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "dsbee.h"
+
+
+namespace dsbee
+{
+	/*
+		The maximum of the last window values pushed, in O(1) time per value.
+			A monotonic deque holds only the values that could still become the maximum.
+			reset() allocates; push() doesn't.
+	*/
+	class SlidingMax
+	{
+	public:
+		void reset(index_t window)
+		{
+			this->window = std::max<index_t>(window, 1);
+
+			// The deque holds at most window entries;  one spare slot keeps back from reaching front.
+			size_t capacity = 1;
+			while (capacity < size_t(this->window) + 1) capacity <<= 1;
+
+			entries.assign(capacity, Entry{0.f, 0});
+			mask  = capacity - 1;
+			front = back = 0;
+			time  = 0;
+		}
+
+		float push(float value)
+		{
+			// Drop the front once it leaves the window, before the new entry can take its slot.
+			if (back != front && entries[front & mask].time + this->window <= time) ++front;
+
+			// Smaller values behind the new one can never be the maximum again.
+			while (back != front && entries[(back-1) & mask].value <= value) --back;
+			entries[back++ & mask] = Entry{value, time};
+
+			++time;
+			return entries[front & mask].value;
+		}
+
+	private:
+		struct Entry
+		{
+			float  value;
+			size_t time;
+		};
+
+		std::vector<Entry> entries;
+		size_t             mask = 0, front = 0, back = 0, time = 0;
+		index_t            window = 1;
+	};
+
+
+	/*
+		Base class for stereo-linked dynamics processors.
+
+			Each block, the loudest channel's level is measured (optionally as true peak,
+			estimated by 4x oversampling), held over the lookahead window,
+			and turned into a gain curve by the subclass.  The gain is then applied
+			to all channels, delayed by the lookahead so reduction begins before a peak.
+
+			Work happens in small blocks on the stack, so the cost per sample
+			doesn't depend on the lookahead length.
+	*/
+	class Dynamics : public Processor
+	{
+	public:
+		enum
+		{
+			MAX_CHANNELS = 8,  // Channels beyond this are silenced
+			BLOCK        = 64,
+		};
+
+		// Lookahead, in milliseconds.  Takes effect on start().
+		float lookaheadMs = 0.f;
+
+		// Measure intersample peaks, adding a few samples of latency.
+		bool truePeak = false;
+
+	public:
+		void start(AudioInfo info) override
+		{
+			sampleRate = info.sampleRate;
+
+			window       = std::max<index_t>(1, index_t(lookaheadMs * .001f * sampleRate));
+			delaySamples = window - 1 + (truePeak ? TRUE_PEAK_DELAY : 0);
+			quietSamples = 0;
+
+			size_t size = 1;
+			while (size < size_t(delaySamples + BLOCK)) size <<= 1;
+			delayLines.assign(MAX_CHANNELS * size, 0.f);
+			delayMask  = size - 1;
+			delayWrite = 0;
+
+			levelHold.reset(window);
+			std::fill(peakHistory, peakHistory + MAX_CHANNELS * 2 * TRUE_PEAK_TAPS, 0.f);
+			peakPosition = 0;
+			if (truePeak) designTruePeak();
+
+			reset();
+		}
+
+		// Stereo-linked by default; wider buses are linked across all their channels.
+		index_t inputChannels () const override    {return 2;}
+		index_t outputChannels() const override    {return 2;}
+
+		index_t latency   () const override    {return delaySamples;}
+		index_t tailLength() const override    {return delaySamples;}
+
+		void process(const float *input, float *output, index_t count) override
+		{
+			Buses<float> buses = {&input, &output, 1, 1, count, false};
+			run(buses);
+		}
+		void process(const double *input, double *output, index_t count) override
+		{
+			Buses<double> buses = {&input, &output, 1, 1, count, false};
+			run(buses);
+		}
+
+		void process(const Buses<float>  &buses) override    {run(buses);}
+		void process(const Buses<double> &buses) override    {run(buses);}
+
+	protected:
+		/*
+			Subclasses:  turn held levels (linear, 0 and up) into linear gains, in place.
+				Called once per block of up to BLOCK samples.
+		*/
+		virtual void computeGain(float *levelToGain, index_t count) = 0;
+
+		// Subclasses:  reset envelope state.  Called from start().
+		virtual void reset() {}
+
+		// Has the delayed audio been silent for the whole lookahead?
+		bool delayIsQuiet() const    {return quietSamples >= delaySamples;}
+
+		// One-pole smoothing coefficient for a time constant in milliseconds.
+		float Coefficient(float ms) const
+		{
+			return (ms > 0.f) ? std::exp(-1.f / (ms * .001f * sampleRate)) : 0.f;
+		}
+
+		static void ToDb(float *x, index_t count)
+		{
+			for (index_t i = 0; i < count; ++i) x[i] = 20.f * std::log10(x[i] + 1e-12f);
+		}
+		static void FromDb(float *x, index_t count)
+		{
+			for (index_t i = 0; i < count; ++i) x[i] = std::pow(10.f, x[i] * .05f);
+		}
+
+	protected:
+		float   sampleRate   = 48000.f;
+		index_t window       = 1; // Lookahead window, in samples
+		index_t delaySamples = 0;
+
+	private:
+		enum
+		{
+			TRUE_PEAK_TAPS   = 8, // FIR taps per oversampled phase
+			TRUE_PEAK_DELAY  = TRUE_PEAK_TAPS / 2,
+			TRUE_PEAK_PHASES = 3, // Points between samples, at 4x oversampling
+		};
+
+		template<typename Sample>
+		void run(const Buses<Sample> &buses)
+		{
+			index_t channels = std::min<index_t>(std::min(buses.inputCount, buses.outputCount), MAX_CHANNELS);
+
+			for (index_t c = channels; c < buses.outputCount; ++c)
+				std::fill(buses.outputs[c], buses.outputs[c] + buses.count, Sample(0));
+
+			for (index_t done = 0; done < buses.count; done += BLOCK)
+			{
+				index_t n = std::min<index_t>(BLOCK, buses.count - done);
+				float gain[BLOCK];
+
+				// Linked detection:  the loudest channel at each sample.
+				std::fill(gain, gain + n, 0.f);
+				for (index_t c = 0; c < channels; ++c)
+				{
+					const Sample *x = buses.inputs[c] + done;
+					if (truePeak) detectTruePeak(c, x, gain, n);
+					else for (index_t i = 0; i < n; ++i) gain[i] = std::max(gain[i], float(std::abs(x[i])));
+				}
+				if (truePeak) peakPosition = (peakPosition + n) % TRUE_PEAK_TAPS;
+
+				bool silent = IsSilent(gain, n);
+				quietSamples = silent ? std::min(quietSamples + n, delaySamples) : 0;
+
+				// Hold peaks across the lookahead window.
+				if (window > 1) for (index_t i = 0; i < n; ++i) gain[i] = levelHold.push(gain[i]);
+
+				computeGain(gain, n);
+
+				// Delay the audio to line up with the gain, and apply it.
+				size_t size = delayMask + 1;
+				for (index_t c = 0; c < channels; ++c)
+				{
+					float *line = delayLines.data() + c * size;
+					const Sample *x = buses.inputs[c] + done;
+					Sample       *y = buses.outputs[c] + done;
+
+					size_t write = delayWrite & delayMask, first = std::min<size_t>(n, size - write);
+					for (size_t i = 0; i < first; ++i) line[write + i]   = float(x[i]);
+					for (size_t i = first; i < size_t(n); ++i) line[i - first] = float(x[i]);
+
+					size_t read = (delayWrite - delaySamples) & delayMask;
+					first = std::min<size_t>(n, size - read);
+					for (size_t i = 0; i < first; ++i) y[i] = Sample(line[read + i] * gain[i]);
+					for (size_t i = first; i < size_t(n); ++i) y[i] = Sample(line[i - first] * gain[i]);
+				}
+				delayWrite += n;
+			}
+		}
+
+		// Peak of each sample and the oversampled points after it, TRUE_PEAK_DELAY samples ago.
+		template<typename Sample>
+		void detectTruePeak(index_t c, const Sample *x, float *level, index_t n)
+		{
+			// History is written twice, so the last TRUE_PEAK_TAPS samples are always contiguous.
+			float  *history = peakHistory + c * 2 * TRUE_PEAK_TAPS;
+			size_t  pos     = peakPosition;
+
+			for (index_t i = 0; i < n; ++i)
+			{
+				float s = float(x[i]);
+				history[pos] = history[pos + TRUE_PEAK_TAPS] = s;
+				pos = (pos + 1) % TRUE_PEAK_TAPS;
+
+				const float *taps = history + pos;
+				float peak = std::max(std::abs(taps[TRUE_PEAK_DELAY-1]), std::abs(taps[TRUE_PEAK_DELAY]));
+				for (int p = 0; p < TRUE_PEAK_PHASES; ++p)
+				{
+					float sum = 0.f;
+					for (int t = 0; t < TRUE_PEAK_TAPS; ++t) sum += taps[t] * truePeakFir[p][t];
+					peak = std::max(peak, std::abs(sum));
+				}
+				level[i] = std::max(level[i], peak);
+			}
+		}
+
+		// Windowed-sinc interpolators for the points 1/4, 2/4 and 3/4 of the way between samples.
+		void designTruePeak()
+		{
+			const float PI = 3.14159265f;
+			for (int p = 0; p < TRUE_PEAK_PHASES; ++p)
+			{
+				float fraction = float(p + 1) / 4.f, sum = 0.f;
+				for (int t = 0; t < TRUE_PEAK_TAPS; ++t)
+				{
+					float u = fraction - float(t - (TRUE_PEAK_DELAY-1));
+					float sinc = std::sin(PI * u) / (PI * u);
+					float hann = .5f + .5f * std::cos(PI * u / float(TRUE_PEAK_DELAY));
+					sum += (truePeakFir[p][t] = sinc * hann);
+				}
+				for (int t = 0; t < TRUE_PEAK_TAPS; ++t) truePeakFir[p][t] /= sum;
+			}
+		}
+
+	private:
+		SlidingMax         levelHold;
+		index_t            quietSamples = 0;
+
+		std::vector<float> delayLines; // One power-of-two ring per channel
+		size_t             delayMask = 0, delayWrite = 0;
+
+		float              peakHistory[MAX_CHANNELS * 2 * TRUE_PEAK_TAPS] = {};
+		size_t             peakPosition = 0;
+		float              truePeakFir[TRUE_PEAK_PHASES][TRUE_PEAK_TAPS] = {};
+	};
+
+
+	/*
+		A feed-forward compressor with a soft knee.
+	*/
+	class Compressor : public Dynamics
+	{
+	public:
+		float thresholdDb = -18.f;
+		float ratio       = 4.f;
+		float kneeDb      = 6.f;
+		float attackMs    = 5.f;
+		float releaseMs   = 100.f;
+		float makeupDb    = 0.f;
+
+		bool isIdle() const override    {return delayIsQuiet() && envelopeDb > -1e-3f;}
+
+	protected:
+		void reset() override    {envelopeDb = 0.f;}
+
+		void computeGain(float *gain, index_t count) override
+		{
+			ToDb(gain, count);
+
+			// Static curve:  gain reduction in dB.
+			float slope = 1.f / std::max(ratio, 1.f) - 1.f, knee = std::max(kneeDb, 1e-3f);
+			for (index_t i = 0; i < count; ++i)
+			{
+				float over = gain[i] - thresholdDb;
+				if      (2.f * over <= -knee) gain[i] = 0.f;
+				else if (2.f * over >=  knee) gain[i] = slope * over;
+				else                          gain[i] = slope * (over + .5f*knee) * (over + .5f*knee) / (2.f*knee);
+			}
+
+			// Attack as reduction increases, release as it recovers.
+			float attack = Coefficient(attackMs), release = Coefficient(releaseMs), env = envelopeDb;
+			for (index_t i = 0; i < count; ++i)
+			{
+				float coef = (gain[i] < env) ? attack : release;
+				gain[i] = env = gain[i] + coef * (env - gain[i]);
+			}
+			envelopeDb = env;
+
+			for (index_t i = 0; i < count; ++i) gain[i] += makeupDb;
+			FromDb(gain, count);
+		}
+
+	private:
+		float envelopeDb = 0.f;
+	};
+
+
+	/*
+		A downward expander (or gate, with a high ratio):  quiet signals get quieter.
+	*/
+	class Expander : public Dynamics
+	{
+	public:
+		float thresholdDb = -40.f;
+		float ratio       = 2.f;
+		float kneeDb      = 6.f;
+		float rangeDb     = -60.f; // The most gain reduction applied
+		float attackMs    = 1.f;
+		float releaseMs   = 100.f;
+
+		bool isIdle() const override    {return delayIsQuiet();}
+
+	protected:
+		void reset() override    {envelopeDb = rangeDb;}
+
+		void computeGain(float *gain, index_t count) override
+		{
+			ToDb(gain, count);
+
+			float slope = std::max(ratio, 1.f) - 1.f, knee = std::max(kneeDb, 1e-3f);
+			for (index_t i = 0; i < count; ++i)
+			{
+				float under = gain[i] - thresholdDb;
+				if      (2.f * under >=  knee) gain[i] = 0.f;
+				else if (2.f * under <= -knee) gain[i] = slope * under;
+				else                           gain[i] = -slope * (under - .5f*knee) * (under - .5f*knee) / (2.f*knee);
+				gain[i] = std::max(gain[i], rangeDb);
+			}
+
+			// Attack as the signal rises (the gain opens), release as it falls.
+			float attack = Coefficient(attackMs), release = Coefficient(releaseMs), env = envelopeDb;
+			for (index_t i = 0; i < count; ++i)
+			{
+				float coef = (gain[i] > env) ? attack : release;
+				gain[i] = env = gain[i] + coef * (env - gain[i]);
+			}
+			envelopeDb = env;
+
+			FromDb(gain, count);
+		}
+
+	private:
+		float envelopeDb = 0.f;
+	};
+
+
+	/*
+		A lookahead brickwall limiter.  Output never exceeds the ceiling (as true peak, by default).
+
+			The gain needed for each held peak is smoothed by a moving average
+			as long as the lookahead, so it reaches its target before the peak arrives.
+	*/
+	class Limiter : public Dynamics
+	{
+	public:
+		float ceilingDb = -1.f;
+		float releaseMs = 50.f;
+
+		Limiter()    {lookaheadMs = 1.5f; truePeak = true;}
+
+		bool isIdle() const override    {return delayIsQuiet() && envelope > 1.f - 1e-6f && averageSum > window - 1e-3;}
+
+		void start(AudioInfo info) override
+		{
+			Dynamics::start(info);
+			averageLine.assign(window, 1.f);
+		}
+
+	protected:
+		void reset() override
+		{
+			envelope = 1.f;
+			averageSum = double(window);
+			averagePos = 0;
+		}
+
+		void computeGain(float *gain, index_t count) override
+		{
+			float ceiling = std::pow(10.f, ceilingDb * .05f), release = Coefficient(releaseMs);
+			for (index_t i = 0; i < count; ++i) gain[i] = std::min(1.f, ceiling / std::max(gain[i], 1e-12f));
+
+			// Instant attack, smooth release; never above the required gain.
+			float env = envelope;
+			for (index_t i = 0; i < count; ++i)
+			{
+				env = std::min(gain[i], 1.f + release * (env - 1.f));
+				gain[i] = env;
+			}
+			envelope = env;
+
+			// Moving average over the lookahead window, in O(1) per sample.
+			if (window > 1)
+			{
+				double sum = averageSum, scale = 1.0 / double(window);
+				for (index_t i = 0; i < count; ++i)
+				{
+					sum += gain[i] - averageLine[averagePos];
+					averageLine[averagePos] = gain[i];
+					if (++averagePos == size_t(window)) averagePos = 0;
+					gain[i] = float(sum * scale);
+				}
+				averageSum = sum;
+			}
+		}
+
+	private:
+		float              envelope = 1.f;
+		std::vector<float> averageLine; // The last window gains
+		double             averageSum = 0.0;
+		size_t             averagePos = 0;
+	};
+}
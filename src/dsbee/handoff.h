@@ -0,0 +1,95 @@
+#pragma once
+
+
+#include <atomic>
+
+
+namespace dsbee
+{
+	/*
+		Hands objects from a control thread (UI, host, loader) to the audio thread without locking.
+
+			The control thread calls publish() with a new object.
+			The audio thread calls acquire() at the start of each block to pick it up.
+
+			When a new object replaces the current one, the old one is "retired",
+			and deleted by the control thread on its next publish() or collect().
+			The audio thread never allocates or frees memory through this class.
+	*/
+	template<typename T>
+	class Handoff
+	{
+	private:
+		std::atomic<T*> pending {nullptr}; // Published, not yet picked up
+		std::atomic<T*> retired {nullptr}; // Replaced, awaiting deletion
+		T              *current = nullptr; // Owned by the audio thread
+
+	public:
+		Handoff() {}
+		~Handoff()    {delete pending.load(); delete retired.load(); delete current;}
+
+		Handoff(const Handoff&) = delete;
+		Handoff &operator=(const Handoff&) = delete;
+
+		/*
+			Control thread:  publish a new object, taking ownership of it.
+				An object that was published but never picked up is deleted.
+		*/
+		void publish(T *object)
+		{
+			collect();
+			delete pending.exchange(object, std::memory_order_acq_rel);
+		}
+
+		/*
+			Control thread:  delete any object the audio thread has retired.
+		*/
+		void collect()
+		{
+			delete retired.exchange(nullptr, std::memory_order_acquire);
+		}
+
+		/*
+			Control thread:  take back a published object the audio thread hasn't picked up yet.
+				Returns nullptr if there was none.  Useful for merging into the next publish().
+		*/
+		T *reclaim()
+		{
+			return pending.exchange(nullptr, std::memory_order_acq_rel);
+		}
+
+		/*
+			Control thread:  is there a published object the audio thread hasn't picked up?
+		*/
+		bool hasPending() const    {return pending.load(std::memory_order_acquire) != nullptr;}
+
+		/*
+			Audio thread:  pick up the newest published object, making it current.
+				Returns the new object, or nullptr if nothing new has arrived.
+				A new object is only picked up once the previous one can be retired,
+				so this may lag behind publish() by a block if collect() is slow.
+		*/
+		T *receive()
+		{
+			if (pending.load(std::memory_order_relaxed) && !retired.load(std::memory_order_acquire))
+			{
+				if (T *next = pending.exchange(nullptr, std::memory_order_acq_rel))
+				{
+					retired.store(current, std::memory_order_release);
+					return current = next;
+				}
+			}
+			return nullptr;
+		}
+
+		/*
+			Audio thread:  pick up any new object and return the current one.
+		*/
+		T *acquire()    {receive(); return current;}
+
+		/*
+			Audio thread:  the current object, without checking for a new one.
+		*/
+		T *get() const    {return current;}
+	};
+}
@@ -0,0 +1,199 @@
+#define _CRT_SECURE_NO_WARNINGS 1
+
+#include "hot_reload.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <dlfcn.h>
+#endif
+
+
+using namespace dsbee;
+
+
+namespace
+{
+	typedef Processor *(*GetProcessorFunc)();
+
+	/*
+		A loaded copy of the library, unloaded and deleted when the last reference goes.
+	*/
+	class Library
+	{
+	public:
+		Library(const std::string &path) : path(path)
+		{
+#if defined(_WIN32)
+			handle = (void*) LoadLibraryA(path.c_str());
+#else
+			handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+#endif
+		}
+
+		~Library()
+		{
+#if defined(_WIN32)
+			if (handle) FreeLibrary((HMODULE) handle);
+#else
+			if (handle) dlclose(handle);
+#endif
+			std::remove(path.c_str());
+		}
+
+		GetProcessorFunc getProcessor() const
+		{
+			if (!handle) return nullptr;
+#if defined(_WIN32)
+			return (GetProcessorFunc) GetProcAddress((HMODULE) handle, "DSBee_GetProcessor");
+#else
+			return (GetProcessorFunc) dlsym(handle, "DSBee_GetProcessor");
+#endif
+		}
+
+	private:
+		std::string path;
+		void       *handle;
+	};
+
+	/*
+		A processor from a library, which keeps the library loaded while it exists.
+	*/
+	class LibraryProcessor : public Processor
+	{
+	public:
+		LibraryProcessor(Processor *inner, std::shared_ptr<Library> library) : inner(inner), library(library) {}
+
+		// The processor's code lives in the library, so it must go first.
+		~LibraryProcessor()    {delete inner; inner = nullptr;}
+
+		void start(AudioInfo info) override                                    {inner->start(info);}
+		void process(const float  *input, float  *output, index_t count) override    {inner->process(input, output, count);}
+		void process(const double *input, double *output, index_t count) override    {inner->process(input, output, count);}
+		void process(const Buses<float>  &buses) override                      {inner->process(buses);}
+		void process(const Buses<double> &buses) override                      {inner->process(buses);}
+
+		index_t inputChannels () const override         {return inner->inputChannels();}
+		index_t outputChannels() const override         {return inner->outputChannels();}
+		void    midiIn(const UMP &event) override       {inner->midiIn(event);}
+		void    midiInAt(const UMP &event, index_t offset) override    {inner->midiInAt(event, offset);}
+		void    sysExIn(const SysEx_Event &event) override    {inner->sysExIn(event);}
+		index_t latency() const override                {return inner->latency();}
+		bool    isIdle() const override                 {return inner->isIdle();}
+		index_t tailLength() const override             {return inner->tailLength();}
+		void    setBypass(bool bypass) override         {inner->setBypass(bypass);}
+		void    saveState(StateWriter &writer) const override    {inner->saveState(writer);}
+		bool    loadState(StateReader &reader) override          {return inner->loadState(reader);}
+
+	private:
+		Processor               *inner;
+		std::shared_ptr<Library> library;
+	};
+
+	// Modification time and size; a file still being written keeps changing.
+	struct FileStamp
+	{
+		long long time = 0, size = -1;
+
+		bool operator==(const FileStamp &o) const    {return time == o.time && size == o.size;}
+		bool operator!=(const FileStamp &o) const    {return !(*this == o);}
+	};
+
+	FileStamp Stamp(const std::string &path)
+	{
+		FileStamp stamp;
+		struct stat info;
+		if (stat(path.c_str(), &info) == 0)
+		{
+			stamp.time = (long long) info.st_mtime;
+			stamp.size = (long long) info.st_size;
+		}
+		return stamp;
+	}
+
+	bool CopyLibrary(const std::string &from, const std::string &to)
+	{
+		FILE *in = fopen(from.c_str(), "rb");
+		if (!in) return false;
+		FILE *out = fopen(to.c_str(), "wb");
+		if (!out) {fclose(in); return false;}
+
+		char buffer[16384];
+		size_t n;
+		bool ok = true;
+		while (ok && (n = fread(buffer, 1, sizeof(buffer), in)) > 0) ok = (fwrite(buffer, 1, n, out) == n);
+		ok &= !ferror(in);
+
+		fclose(in);
+		ok &= (fclose(out) == 0);
+		return ok;
+	}
+}
+
+
+HotReload::HotReload(HotSwap &slot, const std::string &libraryPath,
+	std::function<void()> onLoad, unsigned pollMilliseconds) :
+	slot(slot), libraryPath(libraryPath), onLoad(onLoad), pollMilliseconds(pollMilliseconds)
+{
+	watcher = std::thread(&HotReload::watch, this);
+}
+
+HotReload::~HotReload()
+{
+	stopping = true;
+	if (watcher.joinable()) watcher.join();
+}
+
+bool HotReload::reload()
+{
+	// Each load gets its own copy; some platforms won't load the same path twice.
+	std::string copyPath = libraryPath + ".live" + std::to_string((unsigned long long) (uintptr_t) this)
+		+ "-" + std::to_string(++copyCount);
+	if (!CopyLibrary(libraryPath, copyPath))
+	{
+		std::remove(copyPath.c_str());
+		return false;
+	}
+
+	std::shared_ptr<Library> library = std::make_shared<Library>(copyPath);
+	GetProcessorFunc getProcessor = library->getProcessor();
+	Processor *processor = getProcessor ? getProcessor() : nullptr;
+	if (!processor) return false;
+
+	slot.replace(new LibraryProcessor(processor, library));
+	++loads;
+	if (onLoad) onLoad();
+	return true;
+}
+
+void HotReload::watch()
+{
+	FileStamp loaded = Stamp(libraryPath), previous = loaded;
+
+	while (!stopping)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(pollMilliseconds));
+
+		// Free processors from older builds as their crossfades finish.
+		slot.collect();
+
+		// Reload once the file has changed and stayed the same for one poll.
+		FileStamp stamp = Stamp(libraryPath);
+		if (stamp != loaded && stamp == previous && stamp.size > 0)
+		{
+			reload();
+			loaded = stamp;
+		}
+		previous = stamp;
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include "hot_swap.h"
+
+
+/*
+	Put this in one source file of a processor library (a DLL or shared object)
+		to make its GetProcessor() loadable by HotReload.
+		On ELF platforms, build with -fvisibility=hidden, or the host's own GetProcessor may be called instead.
+*/
+#if defined(_WIN32)
+	#define DSBEE_EXPORT extern "C" __declspec(dllexport)
+#else
+	#define DSBEE_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+#define DSBEE_RELOADABLE \
+	DSBEE_EXPORT dsbee::Processor *DSBee_GetProcessor()    {return dsbee::GetProcessor();}
+
+
+namespace dsbee
+{
+	/*
+		Reloads a processor from a shared library whenever the library is rebuilt.
+
+			A watcher thread polls the library file.  When it changes and has finished
+			being written, the library is loaded from a private copy (so the compiler can
+			overwrite the original), and its processor is created, started and swapped
+			into the HotSwap, all off the audio thread.
+
+			A library stays loaded until the last processor created from it is deleted.
+			If loading fails, the current processor keeps running.
+			onLoad, if given, is called after each successful load, on the loading thread.
+	*/
+	class HotReload
+	{
+	public:
+		HotReload(HotSwap &slot, const std::string &libraryPath,
+			std::function<void()> onLoad = nullptr, unsigned pollMilliseconds = 250);
+		~HotReload();
+
+		HotReload(const HotReload&) = delete;
+		HotReload &operator=(const HotReload&) = delete;
+
+		/*
+			Load the library now, from the calling thread.  Returns false on failure.
+		*/
+		bool reload();
+
+		/*
+			Number of successful loads so far.
+		*/
+		unsigned loadCount() const    {return loads.load(std::memory_order_relaxed);}
+
+	private:
+		void watch();
+
+	private:
+		HotSwap              &slot;
+		std::string           libraryPath;
+		std::function<void()> onLoad;
+		unsigned              pollMilliseconds;
+		std::atomic<unsigned> copyCount {0};
+		std::atomic<unsigned> loads {0};
+		std::atomic<bool>     stopping {false};
+		std::thread           watcher;
+	};
+}
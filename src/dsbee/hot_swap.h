@@ -0,0 +1,268 @@
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+#include "dsbee.h"
+
+
+namespace dsbee
+{
+	/*
+		A processor slot whose contents can be replaced while audio is running.
+
+			A control thread builds a new processor (or Chain) and passes it to replace(),
+			which starts it on the calling thread and publishes it to the audio thread.
+			The audio thread swaps it in between blocks, crossfading from the old processor,
+			and hands the old one back to be deleted by the next replace() or collect().
+			The audio thread never allocates, frees or starts a processor.
+
+		Use a HotSwap as the top-level processor to replace a whole graph,
+			or add one to a Chain to make a single stage replaceable.
+		replace(), collect() and start() may be called from several control threads at once.
+	*/
+	class HotSwap : public Processor
+	{
+	public:
+		enum
+		{
+			MAX_CHANNELS = 8,  // Channels crossfaded; any beyond this are silent during a fade
+			FADE_BLOCK   = 64, // Crossfades run in blocks of this many samples, on the stack
+		};
+
+		explicit HotSwap(Processor *initial, float fadeSeconds = .010f) :
+			current(initial), latest(initial), fadeSeconds(fadeSeconds) {}
+
+		~HotSwap()
+		{
+			delete pending.load();
+			delete retired.load();
+			delete outgoing;
+			delete current;
+		}
+
+		HotSwap(const HotSwap&) = delete;
+		HotSwap &operator=(const HotSwap&) = delete;
+
+		/*
+			Control thread:  replace the processor, taking ownership of the new one.
+				If audio has started, the new processor is started here, off the audio thread.
+				A replacement that was never picked up is deleted.
+		*/
+		void replace(Processor *next)
+		{
+			std::lock_guard<std::mutex> lock(control);
+			if (started) next->start(info);
+			collectRetired();
+			latest = next;
+			delete pending.exchange(next, std::memory_order_acq_rel);
+		}
+
+		/*
+			Control thread:  delete any processor the audio thread has finished with.
+		*/
+		void collect()
+		{
+			std::lock_guard<std::mutex> lock(control);
+			collectRetired();
+		}
+
+		/*
+			Control thread:  is a replacement waiting to be swapped in or fading in?
+				Call collect() once this is false to free the old processor promptly.
+		*/
+		bool swapping() const    {return pending.load(std::memory_order_acquire) || fading.load(std::memory_order_acquire);}
+
+		/*
+			The most recently supplied processor.  Control thread only.
+		*/
+		Processor *get() const    {return latest;}
+
+
+		/*
+			Called while audio is stopped:  any pending swap completes immediately.
+		*/
+		void start(AudioInfo info) override
+		{
+			std::lock_guard<std::mutex> lock(control);
+			if (Processor *next = pending.exchange(nullptr, std::memory_order_acq_rel))
+			{
+				delete outgoing;
+				delete current;
+				outgoing = nullptr;
+				current  = next;
+				fading.store(false, std::memory_order_release);
+			}
+			collectRetired();
+
+			this->info = info;
+			started    = true;
+			fadeLength = index_t(fadeSeconds * info.sampleRate);
+			if (current) current->start(info);
+		}
+
+		void process(const float *input, float *output, index_t count) override
+		{
+			Buses<float> buses = {&input, &output, 1, 1, count, false};
+			swapAndProcess(buses);
+		}
+		void process(const double *input, double *output, index_t count) override
+		{
+			Buses<double> buses = {&input, &output, 1, 1, count, false};
+			swapAndProcess(buses);
+		}
+
+		void process(const Buses<float>  &buses) override    {swapAndProcess(buses);}
+		void process(const Buses<double> &buses) override    {swapAndProcess(buses);}
+
+		// Audio thread:  events and bypass reach both processors during a crossfade.
+		//   A waiting replacement is picked up first, so it sees events from the block it starts in.
+		void midiIn(const UMP &event) override
+		{
+			receive();
+			if (current)  current ->midiIn(event);
+			if (outgoing) outgoing->midiIn(event);
+		}
+		void midiInAt(const UMP &event, index_t offset) override
+		{
+			receive();
+			if (current)  current ->midiInAt(event, offset);
+			if (outgoing) outgoing->midiInAt(event, offset);
+		}
+		void sysExIn(const SysEx_Event &event) override
+		{
+			receive();
+			if (current)  current ->sysExIn(event);
+			if (outgoing) outgoing->sysExIn(event);
+		}
+		void setBypass(bool bypass) override
+		{
+			receive();
+			if (current)  current ->setBypass(bypass);
+			if (outgoing) outgoing->setBypass(bypass);
+		}
+		bool loadState(StateReader &reader) override    {receive(); return current ? current->loadState(reader) : false;}
+
+		// Not idle while a replacement waits, so that the next process() call swaps it in.
+		bool isIdle() const override
+		{
+			return !outgoing && !pending.load(std::memory_order_acquire) && (!current || current->isIdle());
+		}
+
+		// Control thread:  these describe the newest processor.
+		//   They hold the control lock, since a concurrent replace() may delete it.
+		index_t inputChannels () const override    {std::lock_guard<std::mutex> lock(control); return latest ? latest->inputChannels () : 1;}
+		index_t outputChannels() const override    {std::lock_guard<std::mutex> lock(control); return latest ? latest->outputChannels() : 1;}
+		index_t latency       () const override    {std::lock_guard<std::mutex> lock(control); return latest ? latest->latency()        : 0;}
+		index_t tailLength    () const override    {std::lock_guard<std::mutex> lock(control); return latest ? latest->tailLength()     : TAIL_NONE;}
+		void saveState(StateWriter &writer) const override    {std::lock_guard<std::mutex> lock(control); if (latest) latest->saveState(writer);}
+
+
+	private:
+		void collectRetired()
+		{
+			delete retired.exchange(nullptr, std::memory_order_acquire);
+		}
+
+		// Audio thread:  pick up a replacement, unless the last one is still fading in.
+		void receive()
+		{
+			if (outgoing || !pending.load(std::memory_order_relaxed) || retired.load(std::memory_order_acquire)) return;
+
+			if (Processor *next = pending.exchange(nullptr, std::memory_order_acq_rel))
+			{
+				if (current && fadeLength > 0)
+				{
+					outgoing     = current;
+					fadePosition = 0;
+					fading.store(true, std::memory_order_release);
+				}
+				else retired.store(current, std::memory_order_release);
+				current = next;
+			}
+		}
+
+		template<typename Sample>
+		void swapAndProcess(const Buses<Sample> &buses)
+		{
+			receive();
+
+			if (!current)
+			{
+				for (index_t c = 0; c < buses.outputCount; ++c)
+					std::fill(buses.outputs[c], buses.outputs[c] + buses.count, Sample(0));
+			}
+			else if (!outgoing) current->process(buses);
+			else                crossfade(buses);
+		}
+
+		template<typename Sample>
+		void crossfade(const Buses<Sample> &buses)
+		{
+			index_t inputCount  = std::min<index_t>(buses.inputCount,  MAX_CHANNELS);
+			index_t outputCount = std::min<index_t>(buses.outputCount, MAX_CHANNELS);
+
+			// Both processors read a copy of the input, in case the host processes in-place.
+			Sample        input[MAX_CHANNELS][FADE_BLOCK], old[MAX_CHANNELS][FADE_BLOCK];
+			const Sample *inputs[MAX_CHANNELS];
+			Sample       *outputs[MAX_CHANNELS], *olds[MAX_CHANNELS];
+			for (index_t c = 0; c < MAX_CHANNELS; ++c) {inputs[c] = input[c]; olds[c] = old[c];}
+
+			for (index_t c = outputCount; c < buses.outputCount; ++c)
+				std::fill(buses.outputs[c], buses.outputs[c] + buses.count, Sample(0));
+
+			for (index_t done = 0; done < buses.count; done += FADE_BLOCK)
+			{
+				index_t n = std::min<index_t>(FADE_BLOCK, buses.count - done);
+				for (index_t c = 0; c < inputCount; ++c)
+					std::copy(buses.inputs[c] + done, buses.inputs[c] + done + n, input[c]);
+				for (index_t c = 0; c < outputCount; ++c)
+					outputs[c] = buses.outputs[c] + done;
+
+				Buses<Sample> chunk = {inputs, outputs, inputCount, outputCount, n, buses.silentInput};
+				current->process(chunk);
+				if (!outgoing) continue;
+
+				chunk.outputs = olds;
+				outgoing->process(chunk);
+
+				for (index_t c = 0; c < outputCount; ++c)
+				{
+					for (index_t i = 0; i < n; ++i)
+					{
+						float mix = std::min(1.f, float(fadePosition + i + 1) / float(fadeLength));
+						outputs[c][i] = Sample(old[c][i] + (outputs[c][i] - old[c][i]) * mix);
+					}
+				}
+
+				fadePosition += n;
+				if (fadePosition >= fadeLength)
+				{
+					retired.store(outgoing, std::memory_order_release);
+					outgoing = nullptr;
+					fading.store(false, std::memory_order_release);
+				}
+			}
+		}
+
+	private:
+		std::atomic<Processor*> pending {nullptr}; // Replacement, not yet picked up
+		std::atomic<Processor*> retired {nullptr}; // Finished with, awaiting deletion
+		std::atomic<bool>       fading  {false};
+
+		// Audio thread
+		Processor *current;
+		Processor *outgoing     = nullptr; // Fading out
+		index_t    fadePosition = 0;
+
+		// Control threads
+		mutable std::mutex control;
+		Processor *latest;
+		AudioInfo  info = {};
+		bool       started = false;
+		float      fadeSeconds;
+		index_t    fadeLength = 0;
+	};
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "dsbee.h"
+
+
+namespace dsbee
+{
+	/*
+		Holds MIDI events until the block they fall in, then delivers them with their offset.
+
+			Times are in samples on a running clock kept by the caller (see release()).
+			Events are kept in time order, in space allocated up front;  they usually arrive
+			in order, so inserting is cheap.  Events at the same time keep their arrival order.
+
+			Ordering:  only UMP events are queued.  Input delivered immediately (like SysEx) should
+			be preceded by a release() up to its own position, so that everything due at or
+			before it reaches the processor first.  release() may be called several times
+			for one block;  offsets are always relative to blockStart.
+	*/
+	class MidiScheduler
+	{
+	public:
+		using sampletime_t = int64_t;
+
+	public:
+		MidiScheduler(size_t capacity = 1024)    : entries(capacity), count(0), dropCount(0) {}
+
+		/*
+			Queue an event to take effect at a given time.
+				Returns false, dropping the event, if the queue is full.
+		*/
+		bool schedule(sampletime_t time, const UMP &event)
+		{
+			if (count == entries.size()) {++dropCount; return false;}
+
+			size_t i = count++;
+			for (; i > 0 && entries[i-1].time > time; --i) entries[i] = entries[i-1];
+			entries[i] = Entry{time, event};
+			return true;
+		}
+
+		/*
+			Deliver the events due in a block of blockLength samples starting at blockStart,
+				as deliver(const UMP &event, index_t offset).  Late events get offset 0.
+		*/
+		template<typename Deliver>
+		void release(sampletime_t blockStart, index_t blockLength, Deliver &&deliver)
+		{
+			size_t due = 0;
+			while (due < count && entries[due].time < blockStart + blockLength)
+			{
+				sampletime_t offset = entries[due].time - blockStart;
+				deliver(static_cast<const UMP&>(entries[due].event), index_t(offset > 0 ? offset : 0));
+				++due;
+			}
+			if (!due) return;
+			std::copy(entries.begin() + due, entries.begin() + count, entries.begin());
+			count -= due;
+		}
+
+		void   clear()          {count = 0;}
+		size_t size   () const  {return count;}
+		size_t dropped() const  {return dropCount;}
+
+	private:
+		struct Entry
+		{
+			sampletime_t time;
+			UMP          event;
+		};
+
+		std::vector<Entry> entries;
+		size_t             count;
+		size_t             dropCount;
+	};
+}
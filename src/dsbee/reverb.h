@@ -0,0 +1,182 @@
+#pragma once
+
+
+#include <algorithm>
+#include <cmath>
+
+#include "dsbee.h"
+#include "delay.h"
+
+
+namespace dsbee
+{
+	/*
+		A feedback delay network reverb.
+
+			8 or 16 delay lines feed back into each other through a Hadamard matrix,
+			applied as a fast transform (N log N adds, across all lines at once).
+			Each line has a gain for the decay time and a one-pole lowpass for damping,
+			and its length is slowly modulated to avoid metallic ringing.
+
+			Cost per sample is fixed, however long the tail.
+			Delay memory is allocated in start(), for the sample rate.
+	*/
+	class Reverb : public Processor
+	{
+	public:
+		enum { MAX_LINES = 16, BLOCK = 64 };
+
+		index_t lines        = 8;     // 8 or 16; takes effect on start()
+		float   sizeMs       = 60.f;  // Average delay line length; takes effect on start()
+		float   decaySeconds = 2.f;   // Time to decay by 60 dB (RT60)
+		float   dampingHz    = 6000.f;
+		float   modulationMs = .25f;
+		float   rateHz       = .6f;
+		float   mix          = .3f;
+
+	public:
+		void start(AudioInfo info) override
+		{
+			sampleRate = info.sampleRate;
+			lineCount  = (lines > 8) ? 16 : 8;
+
+			// Lengths spread over a 1:3 range, with mutually prime-ish sample counts.
+			float depth = modulationMs * .001f * sampleRate;
+			for (index_t l = 0; l < lineCount; ++l)
+			{
+				float spread = std::pow(3.f, float(l) / float(lineCount - 1)) * .5f;
+				index_t length = index_t(sizeMs * .001f * sampleRate * spread);
+				length |= 1;
+				length = std::max<index_t>(length, index_t(depth) + 3);
+
+				delayLength[l] = float(length);
+				delays[l].reset(length + index_t(depth) + 2, 1);
+				lowpass[l] = 0.f;
+				modulation[l].phase = float(l) / float(lineCount);
+			}
+			quietSamples = 0;
+		}
+
+		index_t inputChannels () const override    {return 2;}
+		index_t outputChannels() const override    {return 2;}
+
+		// The tail decays by 120 dB in twice the RT60.
+		index_t tailLength() const override    {return index_t(2.f * decaySeconds * sampleRate);}
+		bool    isIdle    () const override    {return quietSamples >= tailLength();}
+
+		void process(const float *input, float *output, index_t count) override
+		{
+			Buses<float> buses = {&input, &output, 1, 1, count, false};
+			dispatch(buses);
+		}
+		void process(const double *input, double *output, index_t count) override
+		{
+			Buses<double> buses = {&input, &output, 1, 1, count, false};
+			dispatch(buses);
+		}
+
+		void process(const Buses<float>  &buses) override    {dispatch(buses);}
+		void process(const Buses<double> &buses) override    {dispatch(buses);}
+
+	private:
+		template<typename Sample>
+		void dispatch(const Buses<Sample> &buses)
+		{
+			if (lineCount == 16) run<16>(buses);
+			else                 run<8> (buses);
+		}
+
+		// In-place fast Walsh-Hadamard transform, scaled to be orthogonal.
+		template<int N>
+		static void Hadamard(float *v)
+		{
+			for (int h = 1; h < N; h *= 2)
+			{
+				for (int i = 0; i < N; i += 2*h)
+				{
+					for (int j = i; j < i + h; ++j)
+					{
+						float a = v[j], b = v[j+h];
+						v[j] = a + b; v[j+h] = a - b;
+					}
+				}
+			}
+			const float scale = 1.f / std::sqrt(float(N));
+			for (int i = 0; i < N; ++i) v[i] *= scale;
+		}
+
+		template<int N, typename Sample>
+		void run(const Buses<Sample> &buses)
+		{
+			// Mono input feeds both sides; wider buses use their first two channels.
+			const Sample *inL = buses.inputCount ? buses.inputs[0] : nullptr;
+			const Sample *inR = buses.inputCount ? buses.inputs[std::min<index_t>(1, buses.inputCount - 1)] : nullptr;
+			Sample *outL = buses.outputCount > 0 ? buses.outputs[0] : nullptr;
+			Sample *outR = buses.outputCount > 1 ? buses.outputs[1] : nullptr;
+
+			for (index_t c = 2; c < buses.outputCount; ++c)
+				std::fill(buses.outputs[c], buses.outputs[c] + buses.count, Sample(0));
+
+			// Per-line decay gains and damping, from the current settings.
+			float gain[N], damping = std::exp(-6.2831853f * dampingHz / sampleRate);
+			for (int l = 0; l < N; ++l)
+				gain[l] = std::pow(10.f, -3.f * delayLength[l] / (std::max(decaySeconds, .01f) * sampleRate));
+
+			float depth = modulationMs * .001f * sampleRate, increment = rateHz / sampleRate;
+			float dryGain = 1.f - mix, wetGain = mix * 2.f / float(N);
+			bool  silent = true;
+
+			for (index_t done = 0; done < buses.count; done += BLOCK)
+			{
+				index_t n = std::min<index_t>(BLOCK, buses.count - done);
+
+				float mod[N][BLOCK];
+				for (int l = 0; l < N; ++l) modulation[l].render(mod[l], n, 0.f, increment);
+
+				for (index_t i = 0; i < n; ++i)
+				{
+					float xL = inL ? float(inL[done+i]) : 0.f, xR = inR ? float(inR[done+i]) : 0.f;
+					if (silent) silent = (std::abs(xL) < SILENCE_THRESHOLD && std::abs(xR) < SILENCE_THRESHOLD);
+
+					// Read every line, then damp and scale for decay.
+					float v[N], wetL = 0.f, wetR = 0.f;
+					for (int l = 0; l < N; ++l) v[l] = delays[l].linear(delayLength[l] - 1.f + depth * mod[l][i]);
+					for (int l = 0; l < N; l += 2) {wetL += v[l]; wetR += v[l+1];}
+					for (int l = 0; l < N; ++l)
+					{
+						lowpass[l] = v[l] + damping * (lowpass[l] - v[l]);
+						v[l] = lowpass[l] * gain[l];
+					}
+
+					// Mix the lines together, then feed in the input:  left to even lines, right to odd.
+					Hadamard<N>(v);
+					for (int l = 0; l < N; l += 2)
+					{
+						delays[l]  .push(v[l]   + xL);
+						delays[l+1].push(v[l+1] + xR);
+					}
+
+					if (outR)
+					{
+						outL[done+i] = Sample(dryGain * xL + wetGain * wetL);
+						outR[done+i] = Sample(dryGain * xR + wetGain * wetR);
+					}
+					else if (outL) outL[done+i] = Sample(dryGain * xL + wetGain * .5f * (wetL + wetR));
+				}
+
+				for (int l = 0; l < N; ++l) modulation[l].advance(n, increment);
+			}
+
+			quietSamples = silent ? std::min<index_t>(quietSamples + buses.count, 0x7FFFFFFF) : 0;
+		}
+
+	private:
+		float     sampleRate = 48000.f;
+		index_t   lineCount  = 8;
+		DelayLine delays[MAX_LINES];
+		float     delayLength[MAX_LINES] = {};
+		float     lowpass[MAX_LINES] = {};
+		BlockLFO  modulation[MAX_LINES];
+		index_t   quietSamples = 0;
+	};
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+
+namespace dsbee
+{
+	/*
+		Two contiguous regions of a ring buffer, for zero-copy access.
+			The second region is used when the span wraps around the end of the buffer.
+			Sizes are in frames; each frame holds one sample per channel, interleaved.
+	*/
+	template<typename T>
+	struct RingSpan
+	{
+		T     *first;
+		size_t firstFrames;
+		T     *second;
+		size_t secondFrames;
+
+		size_t frames() const    {return firstFrames + secondFrames;}
+	};
+
+	/*
+		A wait-free single-producer, single-consumer ring buffer for audio frames.
+			Use it to stream audio between the audio thread and other threads
+			(recording, visualization, lookahead tails...)
+
+		reset() allocates; call it before streaming starts (from start() for processors).
+			After that, one thread may write and one other thread may read, without locks.
+		Capacity is rounded up to a power of two.
+	*/
+	template<typename T = float>
+	class RingBuffer
+	{
+	public:
+		RingBuffer() {}
+		RingBuffer(size_t minFrames, size_t channels = 1)    {reset(minFrames, channels);}
+
+		RingBuffer(const RingBuffer&) = delete;
+		RingBuffer &operator=(const RingBuffer&) = delete;
+
+		/*
+			Allocate space for at least minFrames frames, and empty the buffer.
+				Not thread-safe:  neither side may be using the buffer.
+		*/
+		void reset(size_t minFrames, size_t channels = 1)
+		{
+			size_t frames = 1;
+			while (frames < minFrames) frames <<= 1;
+
+			channelCount = std::max<size_t>(channels, 1);
+			indexMask     = frames - 1;
+			storage.assign(frames * channelCount, T());
+
+			writeIndex.store(0, std::memory_order_relaxed);
+			readIndex .store(0, std::memory_order_relaxed);
+			cachedRead  = 0;
+			cachedWrite = 0;
+		}
+
+		size_t capacity() const    {return storage.size() / channelCount;}
+		size_t channels() const    {return channelCount;}
+
+
+		/*
+			Producer side.
+				writeSpan gets space to write into; commitWrite publishes the frames written.
+				write copies interleaved frames in, returning the number written.
+		*/
+		size_t writeAvailable()    {return writeSpace(size_t(-1));}
+
+		RingSpan<T> writeSpan(size_t maxFrames = size_t(-1))
+		{
+			return span<T>(writeIndex.load(std::memory_order_relaxed), std::min(maxFrames, writeSpace(maxFrames)));
+		}
+
+		void commitWrite(size_t frames)
+		{
+			writeIndex.store(writeIndex.load(std::memory_order_relaxed) + frames, std::memory_order_release);
+		}
+
+		size_t write(const T *frames, size_t count)
+		{
+			RingSpan<T> s = writeSpan(count);
+			std::copy(frames,                               frames + s.firstFrames * channelCount, s.first);
+			std::copy(frames + s.firstFrames * channelCount,   frames + s.frames()    * channelCount, s.second);
+			commitWrite(s.frames());
+			return s.frames();
+		}
+
+
+		/*
+			Consumer side.
+				readSpan gets frames to read from; commitRead releases them.
+				read copies interleaved frames out, returning the number read.
+		*/
+		size_t readAvailable()    {return readSpace(size_t(-1));}
+
+		RingSpan<const T> readSpan(size_t maxFrames = size_t(-1))
+		{
+			return span<const T>(readIndex.load(std::memory_order_relaxed), std::min(maxFrames, readSpace(maxFrames)));
+		}
+
+		void commitRead(size_t frames)
+		{
+			readIndex.store(readIndex.load(std::memory_order_relaxed) + frames, std::memory_order_release);
+		}
+
+		size_t read(T *frames, size_t count)
+		{
+			RingSpan<const T> s = readSpan(count);
+			std::copy(s.first,  s.first  + s.firstFrames  * channelCount, frames);
+			std::copy(s.second, s.second + s.secondFrames * channelCount, frames + s.firstFrames * channelCount);
+			commitRead(s.frames());
+			return s.frames();
+		}
+
+
+	private:
+		// Free and filled space.  The other side's index is only re-read
+		//   when our cached copy doesn't show enough room, saving cache traffic.
+		size_t writeSpace(size_t wanted)
+		{
+			size_t w = writeIndex.load(std::memory_order_relaxed);
+			if (capacity() - (w - cachedRead) < wanted) cachedRead = readIndex.load(std::memory_order_acquire);
+			return capacity() - (w - cachedRead);
+		}
+		size_t readSpace(size_t wanted)
+		{
+			size_t r = readIndex.load(std::memory_order_relaxed);
+			if (cachedWrite - r < wanted) cachedWrite = writeIndex.load(std::memory_order_acquire);
+			return cachedWrite - r;
+		}
+
+		template<typename P>
+		RingSpan<P> span(size_t index, size_t frames)
+		{
+			size_t start = index & indexMask;
+			size_t first = std::min(frames, capacity() - start);
+			P *base = storage.data();
+			return RingSpan<P>{base + start * channelCount, first, base, frames - first};
+		}
+
+	private:
+		enum { CACHE_LINE = 64 };
+
+		// Indices count frames and wrap freely; the mask maps them into storage.
+		//   The consumer's fields are padded onto cache lines of their own.  Padding, not alignas,
+		//   so that classes holding a RingBuffer can still be allocated with new under C++14.
+		std::atomic<size_t> writeIndex {0};
+		size_t              cachedRead = 0;  // Producer's copy of readIndex
+		char                producerPad[CACHE_LINE];
+
+		std::atomic<size_t> readIndex {0};
+		size_t              cachedWrite = 0; // Consumer's copy of writeIndex
+		char                consumerPad[CACHE_LINE];
+
+		std::vector<T> storage;
+		size_t         channelCount = 1;
+		size_t         indexMask    = 0;
+	};
+}
@@ -0,0 +1,279 @@
+#pragma once
+
+
+#include <atomic>
+#include <cmath>
+#include <complex>
+#include <vector>
+
+#include "dsbee.h"
+#include "ring_buffer.h"
+
+
+namespace dsbee
+{
+	/*
+		A visualization tap, which lets a UI thread see the audio passing through it.
+
+			On the audio thread, the tap accumulates peak/RMS meters (decimated to about
+			60 readings per second) and streams a mono mix for scopes and spectra,
+			all through lock-free ring buffers.  FFTs are computed on the reading thread.
+			When nobody is subscribed, the tap costs one atomic load per block.
+
+		Insert a Tap anywhere in a Chain (it passes audio through unchanged),
+			or call feed() from inside any processor.
+	*/
+	class Tap : public Processor
+	{
+	public:
+		enum FEATURE
+		{
+			METER    = 0x1,
+			SCOPE    = 0x2,
+			SPECTRUM = 0x4,
+		};
+
+		enum
+		{
+			MAX_CHANNELS  = 8,
+			METER_RATE    = 60,   // Meter readings per second
+			SCOPE_FRAMES  = 8192, // Scope history that can be buffered between UI reads
+			SPECTRUM_SIZE = 1024, // FFT size; readSpectrum produces half this many bins
+		};
+
+		struct Meter
+		{
+			uint32_t channels = 0;
+			float    peak[MAX_CHANNELS] = {};
+			float    rms [MAX_CHANNELS] = {};
+		};
+
+	public:
+		/*
+			UI thread:  start or stop receiving features (a combination of FEATURE flags).
+				Buffers are allocated on first subscription and kept until the tap is destroyed.
+		*/
+		void subscribe(unsigned features)
+		{
+			if ((features & METER)    && !meterRing   .capacity()) meterRing.reset(METER_RATE);
+			if ((features & SCOPE)    && !scopeRing   .capacity()) scopeRing.reset(SCOPE_FRAMES);
+			if ((features & SPECTRUM) && !spectrumRing.capacity())
+			{
+				spectrumRing.reset(2 * SPECTRUM_SIZE);
+				spectrumWork.resize(SPECTRUM_SIZE);
+			}
+			subscribed.fetch_or(features, std::memory_order_release);
+		}
+		void unsubscribe(unsigned features = METER | SCOPE | SPECTRUM)
+		{
+			subscribed.fetch_and(~features, std::memory_order_release);
+		}
+
+		/*
+			UI thread:  get the latest meter reading.  Returns false if there's nothing new.
+		*/
+		bool readMeter(Meter &meter)
+		{
+			bool any = false;
+			while (meterRing.read(&meter, 1)) any = true;
+			return any;
+		}
+
+		/*
+			UI thread:  get up to count of the most recent scope samples, oldest first.
+				Older samples are discarded.  Returns the number of samples read.
+		*/
+		size_t readScope(float *samples, size_t count)
+		{
+			size_t available = scopeRing.readAvailable();
+			if (available > count) scopeRing.commitRead(available - count);
+			return scopeRing.read(samples, count);
+		}
+
+		/*
+			UI thread:  compute a magnitude spectrum (SPECTRUM_SIZE/2 bins) from the
+				most recent SPECTRUM_SIZE samples.  Returns false if there isn't enough new audio.
+		*/
+		bool readSpectrum(float *magnitudes)
+		{
+			size_t available = spectrumRing.readAvailable();
+			if (available < SPECTRUM_SIZE) return false;
+			spectrumRing.commitRead(available - SPECTRUM_SIZE);
+
+			float window[SPECTRUM_SIZE];
+			spectrumRing.read(window, SPECTRUM_SIZE);
+
+			// Hann window, then FFT.
+			const float TWO_PI = 6.2831853f;
+			for (size_t i = 0; i < SPECTRUM_SIZE; ++i)
+			{
+				float hann = .5f - .5f * std::cos(TWO_PI * float(i) / float(SPECTRUM_SIZE));
+				spectrumWork[i] = std::complex<float>(window[i] * hann, 0.f);
+			}
+			FFT(spectrumWork.data(), SPECTRUM_SIZE);
+
+			for (size_t i = 0; i < SPECTRUM_SIZE/2; ++i)
+			{
+				magnitudes[i] = std::abs(spectrumWork[i]) * (4.f / SPECTRUM_SIZE);
+			}
+			return true;
+		}
+
+
+		/*
+			Audio thread:  feed audio to subscribers.
+		*/
+		template<typename Sample>
+		void feed(const Sample *const *channels, index_t channelCount, index_t count)
+		{
+			unsigned features = subscribed.load(std::memory_order_acquire);
+			if (!features) return;
+
+			channelCount = std::min<index_t>(channelCount, MAX_CHANNELS);
+
+			if (features & METER) accumulateMeter(channels, channelCount, count);
+
+			if (features & (SCOPE | SPECTRUM))
+			{
+				// Mix down to mono in small blocks.
+				enum { BLOCK = 64 };
+				float mono[BLOCK];
+				float scale = 1.f / float(std::max<index_t>(channelCount, 1));
+
+				for (index_t done = 0; done < count; done += BLOCK)
+				{
+					index_t n = std::min<index_t>(BLOCK, count - done);
+					for (index_t i = 0; i < n; ++i)
+					{
+						float sum = 0.f;
+						for (index_t c = 0; c < channelCount; ++c) sum += float(channels[c][done+i]);
+						mono[i] = sum * scale;
+					}
+
+					// If the UI falls behind, samples are dropped.
+					if (features & SCOPE)    scopeRing   .write(mono, n);
+					if (features & SPECTRUM) spectrumRing.write(mono, n);
+				}
+			}
+		}
+
+
+		/*
+			As a chain stage, the tap passes audio through unchanged.
+		*/
+		void start(AudioInfo info) override
+		{
+			meterPeriod = std::max<index_t>(1, index_t(info.sampleRate / METER_RATE));
+			meterCount  = 0;
+		}
+
+		void process(const float  *input, float  *output, index_t count) override    {passThrough(input, output, count);}
+		void process(const double *input, double *output, index_t count) override    {passThrough(input, output, count);}
+
+		void process(const Buses<float>  &buses) override    {passThrough(buses);}
+		void process(const Buses<double> &buses) override    {passThrough(buses);}
+
+		// Keep running on silence while subscribed, so meters fall back to zero.
+		bool    isIdle    () const override    {return subscribed.load(std::memory_order_relaxed) == 0;}
+		index_t tailLength() const override    {return TAIL_NONE;}
+
+
+	private:
+		template<typename Sample>
+		void passThrough(const Sample *input, Sample *output, index_t count)
+		{
+			if (output != input) std::copy(input, input + count, output);
+			feed(&output, 1, count);
+		}
+
+		template<typename Sample>
+		void passThrough(const Buses<Sample> &buses)
+		{
+			for (index_t c = 0; c < buses.outputCount; ++c)
+			{
+				Sample *output = buses.outputs[c];
+				if (c >= buses.inputCount)              std::fill(output, output + buses.count, Sample(0));
+				else if (buses.inputs[c] != output) std::copy(buses.inputs[c], buses.inputs[c] + buses.count, output);
+			}
+			feed(buses.outputs, buses.outputCount, buses.count);
+		}
+
+		template<typename Sample>
+		void accumulateMeter(const Sample *const *channels, index_t channelCount, index_t count)
+		{
+			for (index_t done = 0; done < count; )
+			{
+				index_t n = std::min(count - done, meterPeriod - meterCount);
+				for (index_t c = 0; c < channelCount; ++c)
+				{
+					const Sample *x = channels[c] + done;
+					float peak = meterPeak[c], sum = meterSum[c];
+					for (index_t i = 0; i < n; ++i)
+					{
+						float v = float(x[i]);
+						peak = std::max(peak, std::abs(v));
+						sum += v * v;
+					}
+					meterPeak[c] = peak; meterSum[c] = sum;
+				}
+				done += n; meterCount += n;
+
+				if (meterCount >= meterPeriod)
+				{
+					Meter meter;
+					meter.channels = uint32_t(channelCount);
+					for (index_t c = 0; c < channelCount; ++c)
+					{
+						meter.peak[c] = meterPeak[c];
+						meter.rms [c] = std::sqrt(meterSum[c] / float(meterPeriod));
+						meterPeak[c] = meterSum[c] = 0.f;
+					}
+					meterRing.write(&meter, 1);
+					meterCount = 0;
+				}
+			}
+		}
+
+		// In-place radix-2 FFT; n must be a power of two.
+		static void FFT(std::complex<float> *data, size_t n)
+		{
+			for (size_t i = 1, j = 0; i < n; ++i)
+			{
+				size_t bit = n >> 1;
+				for (; j & bit; bit >>= 1) j ^= bit;
+				j ^= bit;
+				if (i < j) std::swap(data[i], data[j]);
+			}
+			for (size_t len = 2; len <= n; len <<= 1)
+			{
+				float angle = -6.2831853f / float(len);
+				std::complex<float> step(std::cos(angle), std::sin(angle));
+				for (size_t i = 0; i < n; i += len)
+				{
+					std::complex<float> w(1.f, 0.f);
+					for (size_t k = 0; k < len/2; ++k)
+					{
+						std::complex<float> a = data[i+k], b = data[i+k+len/2] * w;
+						data[i+k]         = a + b;
+						data[i+k+len/2]   = a - b;
+						w *= step;
+					}
+				}
+			}
+		}
+
+	private:
+		std::atomic<unsigned> subscribed {0};
+
+		// Audio thread
+		index_t meterPeriod = 800, meterCount = 0;
+		float   meterPeak[MAX_CHANNELS] = {}, meterSum[MAX_CHANNELS] = {};
+
+		// Audio thread to UI thread
+		RingBuffer<Meter> meterRing;
+		RingBuffer<float> scopeRing, spectrumRing;
+
+		// UI thread
+		std::vector<std::complex<float>> spectrumWork;
+	};
+}
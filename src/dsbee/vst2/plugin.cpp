@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "plugin.h"
@@ -17,6 +18,45 @@ DSBeeProgram::DSBeeProgram ()
 	name = "Default";
 }
 
+// Program changes glide to their new values over this long (0 switches instantly),
+//   updating them every kProgramFadeFrames samples.
+static const float kProgramFadeSeconds = 0.010f;
+static const VstInt32 kProgramFadeFrames = 32;
+
+// Soft bypass crossfades between wet and dry over this long.
+static const float kBypassFadeSeconds = 0.010f;
+
+// Latency allowed for JR-timestamped MIDI to arrive, absorbing transport jitter.
+static const double kJitterSeconds = 0.001;
+
+//-----------------------------------------------------------------------------
+static void defaultArrangement (VstSpeakerArrangement& arrangement, VstInt32 channels)
+{
+	static const VstInt32 types[] =
+		{kSpeakerArrEmpty, kSpeakerArrMono, kSpeakerArrStereo, kSpeakerArr30Music, kSpeakerArr40Music,
+		 kSpeakerArr50, kSpeakerArr51, kSpeakerArr70Music, kSpeakerArr71Music};
+
+	// Speakers of each arrangement above, in channel order.
+	static const VstInt32 speakers[][kMaxChannels] =
+	{
+		{},
+		{kSpeakerM},
+		{kSpeakerL, kSpeakerR},
+		{kSpeakerL, kSpeakerR, kSpeakerS},
+		{kSpeakerL, kSpeakerR, kSpeakerLs, kSpeakerRs},
+		{kSpeakerL, kSpeakerR, kSpeakerC, kSpeakerLs, kSpeakerRs},
+		{kSpeakerL, kSpeakerR, kSpeakerC, kSpeakerLfe, kSpeakerLs, kSpeakerRs},
+		{kSpeakerL, kSpeakerR, kSpeakerC, kSpeakerLs, kSpeakerRs, kSpeakerSl, kSpeakerSr},
+		{kSpeakerL, kSpeakerR, kSpeakerC, kSpeakerLfe, kSpeakerLs, kSpeakerRs, kSpeakerSl, kSpeakerSr},
+	};
+
+	memset (&arrangement, 0, sizeof (arrangement));
+	arrangement.type = types[channels];
+	arrangement.numChannels = channels;
+	for (VstInt32 i = 0; i < channels; ++i)
+		arrangement.speakers[i].type = speakers[channels][i];
+}
+
 //-----------------------------------------------------------------------------
 DSBeeEffect::DSBeeEffect (audioMasterCallback audioMaster)
 	: AudioEffectX (audioMaster, kNumPrograms, kNumParams)
@@ -24,31 +64,73 @@ DSBeeEffect::DSBeeEffect (audioMasterCallback audioMaster)
 	programs = new DSBeeProgram[numPrograms];
 	program = programs[0];
 
+	automatedMask = 0;
+	newLatency = -1;
+	fadeLength = fadeRemaining = 0;
+
+	bypassRequested = false;
+	bypassMix = 1.f;
+	bypassStep = 1.f;
+	dryLatency = dryCursor = 0;
+	live[kAmp]  = target[kAmp]  = program.amp;
+	live[kPadX] = target[kPadX] = program.pad_x;
+	live[kPadY] = target[kPadY] = program.pad_y;
+
 	if (programs)
 		setProgram (0);
 
-	setNumInputs (1);	// mono input
-	setNumOutputs (1);	// mono output
+	processor = new dsbee::HotSwap (dsbee::GetProcessor());
+
+	// For fast iteration, DSBEE_RELOAD can name a processor library (built with DSBEE_RELOADABLE).
+	//   It replaces the built-in processor, and is reloaded whenever it is rebuilt.
+	reloader = nullptr;
+	if (const char* library = getenv ("DSBEE_RELOAD"))
+	{
+		reloader = new dsbee::HotReload (*processor, library, [this] { noteLatency (); });
+		reloader->reload ();
+	}
 
-	processor = dsbee::GetProcessor();
+	// Answer MIDI-CI discovery, negotiation and property requests (non-commercial manufacturer ID).
+	midi2::CI_Identity identity;
+	identity.sysExId = 0x7D;
+	ciResponder = new dsbee::CI_Responder (identity);
+
+	// Channel layout comes from the processor graph
+	VstInt32 numIn  = (VstInt32) std::min<dsbee::index_t> (processor->inputChannels (), kMaxChannels);
+	VstInt32 numOut = (VstInt32) std::min<dsbee::index_t> (processor->outputChannels (), kMaxChannels);
+	setNumInputs (numIn);
+	setNumOutputs (numOut);
+	defaultArrangement (inputArrangement, numIn);
+	defaultArrangement (outputArrangement, numOut);
+
+	canProcessReplacing ();
+	canDoubleReplacing ();	// processors run natively in double, or in mixed mode
+	programsAreChunks ();	// program bank and processor state are saved as one binary chunk
+	noTail (processor->tailLength () == dsbee::Processor::TAIL_NONE);
+	setInitialDelay ((VstInt32) processor->latency ());	// lookahead, compensated by the host
 
 	setUniqueID ('iDSB');	// this should be unique, use the Steinberg web page for plugin Id registration
 
-	resume ();		// flush buffer
+	resume ();		// start the processor
 }
 
 //------------------------------------------------------------------------
 DSBeeEffect::~DSBeeEffect ()
 {
-	if (buffer)
-		delete[] buffer;
 	if (programs)
 		delete[] programs;
+	delete reloader;
+	delete ciResponder;
+	delete processor;
 }
 
 VstInt32 DSBeeEffect::canDo(char* text)
 {
-	if (strcmp(text, "receiveVstMidiEvent")) return 1;
+	if (!strcmp(text, "receiveVstEvents")) return 1;	// hosts only call processEvents if we say yes
+	if (!strcmp(text, "receiveVstMidiEvent")) return 1;
+	if (!strcmp(text, "bypass")) return 1;
+	if (!strcmp(text, "sendVstEvents")) return 1;
+	if (!strcmp(text, "sendVstMidiEvent")) return 1;
 
 	return 0;
 }
@@ -56,6 +138,9 @@ VstInt32 DSBeeEffect::canDo(char* text)
 VstInt32 DSBeeEffect::processEvents(VstEvents* events)
 {
 	using namespace midi2;
+	UMP_StreamWriter pending (midiInWords, kMidiInWords);
+	VstInt32 pendingFrames = 0;
+
 	for (VstInt32 i = 0; i < events->numEvents; ++i)
 	{
 		const VstEvent *event = events->events[i];
@@ -65,36 +150,86 @@ VstInt32 DSBeeEffect::processEvents(VstEvents* events)
 			{
 				auto midiEvent = (const VstMidiEvent*) event;
 
+				// Each event holds one message;  the bytes after it are padding.
+				//   SysEx arrives as kVstSysExType instead.
 				auto midiBytes = (const uint8_t*) midiEvent->midiData;
-
-				UMP packet = UMP(
-					(uint32_t(UMP::MIDI1_CHANNEL_VOICE) << 28) |
-					(uint32_t(midiBytes[0]) << 16) |
-					(uint32_t(midiBytes[1]) << 8) |
-					(uint32_t(midiBytes[2])));
-
-				UMP::CV1 &midi1Packet = reinterpret_cast<UMP::CV1&>(packet);
-
-				processor->midiIn(midi1Packet);
+				size_t length = (midiBytes[0] == 0xF0) ? 0 : Midi1_To_UMP::Message_Length (midiBytes[0]);
+
+				// Events at the same position are translated together.
+				if (event->deltaFrames != pendingFrames)
+				{
+					deliverMidi (pending, pendingFrames);
+					pendingFrames = event->deltaFrames;
+				}
+
+				size_t used = midiInput.feed (midiBytes, length, 0, pending);
+				if (used < length)
+				{
+					deliverMidi (pending, pendingFrames);
+					midiInput.feed (midiBytes + used, length - used, 0, pending);
+				}
 			}
 			break;
 		case kVstSysExType:
+			{
+				auto sysExEvent = (const VstMidiSysexEvent*) event;
+
+				// SysEx isn't queued, so MIDI from earlier in the list goes to the processor first.
+				deliverMidi (pending, pendingFrames);
+				releaseMidi (event->deltaFrames + 1);
+				midiReleased = std::max (midiReleased, event->deltaFrames + 1);
+				sysExInput.push_midi1 ((const uint8_t*) sysExEvent->sysexDump, sysExEvent->dumpBytes, 0,
+					[this] (const SysEx_Event& message)
+					{
+						processor->sysExIn (message);
+						ciResponder->push (message);
+					});
+			}
 			break;
 		}
 	}
 
+	deliverMidi (pending, pendingFrames);
 	return 1;
 }
 
+//------------------------------------------------------------------------
+void DSBeeEffect::deliverMidi (midi2::UMP_StreamWriter& pending, VstInt32 deltaFrames)
+{
+	// Messages arrive at their position in the coming block; JR timestamps may move them later.
+	int64_t arrival = sampleClock + deltaFrames;
+	for (midi2::UMP_Stream::Message message : pending.stream ())
+	{
+		midi2::UMP event = message.copy ();
+		if (jrTiming.receive (event, arrival))
+			continue;
+		midiSchedule.schedule (jrTiming.place (event.group (), arrival), event);
+	}
+	pending.clear ();
+}
+
+//------------------------------------------------------------------------
+void DSBeeEffect::releaseMidi (VstInt32 frames)
+{
+	// Scheduled MIDI due in the next frames samples goes to the processor, placed within the block.
+	midiSchedule.release (sampleClock, frames, [this] (const midi2::UMP& event, dsbee::index_t offset)
+	{
+		processor->midiInAt (event, offset);
+	});
+}
+
 //------------------------------------------------------------------------
 void DSBeeEffect::setProgram (VstInt32 program)
 {
 	DSBeeProgram* ap = &programs[std::min<VstInt32>(program, kNumPrograms-1)];
 
 	curProgram = program;
-	setParameter (kPadX, ap->pad_x);	
-	setParameter (kPadY, ap->pad_y);
-	setParameter (kAmp,  ap->amp);
+	this->program.pad_x = ap->pad_x;
+	this->program.pad_y = ap->pad_y;
+	this->program.amp   = ap->amp;
+
+	// The audio thread picks up all values at once.
+	publishSnapshot ();
 }
 
 //------------------------------------------------------------------------
@@ -129,12 +264,217 @@ void DSBeeEffect::resume ()
 	dsbee::AudioInfo info;
 	info.sampleRate = this->sampleRate;
 
+	fadeLength = (VstInt32) (kProgramFadeSeconds * this->sampleRate);
+	bypassStep = 1.f / std::max (1.f, kBypassFadeSeconds * this->sampleRate);
+
 	processor->start(info);
+	outputTap.start(info);
+	sysExInput.reset ();
+	midiInput.reset ();
+	midiSchedule.clear ();
+	jrTiming.configure (this->sampleRate, kJitterSeconds);
+	sampleClock = 0;
+	midiReleased = 0;
+	receiveParameters ();
+
+	// Latency can depend on the sample rate.  Reported with the first block, as resume () also runs
+	//   from the constructor, before the host has the effect.
+	noteLatency ();
+
+	// Size the dry path for the processor's latency, off the audio thread.
+	size_t channels = outputArrangement.numChannels;
+	dryLatency = (VstInt32) processor->latency ();
+	dryCursor = 0;
+	dryDelay.assign (channels * dryLatency, 0.0);
+	dryBlock.assign (channels * this->blockSize, 0.0);
 
-	//memset (buffer, 0, size * sizeof (float));
 	AudioEffectX::resume ();
 }
 
+//------------------------------------------------------------------------
+void DSBeeEffect::writeChunk (dsbee::StateWriter& writer, bool isPreset)
+{
+	VstInt32 first = isPreset ? curProgram : 0;
+	VstInt32 count = isPreset ? 1 : kNumPrograms;
+
+	writer.write (uint32_t (kChunkMagic));
+	writer.write (uint16_t (kChunkVersion));
+	writer.write (uint16_t (isPreset ? kChunkPreset : 0));
+	writer.write (uint32_t (count));
+	writer.write (int32_t (curProgram));
+
+	for (VstInt32 i = first; i < first + count; ++i)
+	{
+		const DSBeeProgram& ap = programs[i];
+		uint8_t nameLength = (uint8_t) std::min<size_t> (ap.name.size (), kVstMaxProgNameLen);
+		writer.write (ap.amp);
+		writer.write (ap.pad_x);
+		writer.write (ap.pad_y);
+		writer.write (nameLength);
+		writer.writeBytes (ap.name.data (), nameLength);
+	}
+
+	// Current parameter values
+	writer.write (program.amp);
+	writer.write (program.pad_x);
+	writer.write (program.pad_y);
+
+	// Processor state, prefixed with its size
+	size_t sizeAt = writer.size ();
+	writer.write (uint32_t (0));
+	processor->saveState (writer);
+	writer.patch (sizeAt, uint32_t (writer.size () - sizeAt - sizeof (uint32_t)));
+}
+
+//------------------------------------------------------------------------
+VstInt32 DSBeeEffect::getChunk (void** data, bool isPreset)
+{
+	// Measure, then write.
+	dsbee::StateWriter measure;
+	writeChunk (measure, isPreset);
+
+	chunk.resize (measure.size ());
+	dsbee::StateWriter writer (chunk.data (), chunk.size ());
+	writeChunk (writer, isPreset);
+
+	*data = chunk.data ();
+	return (VstInt32) writer.size ();
+}
+
+//------------------------------------------------------------------------
+VstInt32 DSBeeEffect::setChunk (void* data, VstInt32 byteSize, bool isPreset)
+{
+	dsbee::StateReader reader ((const uint8_t*) data, byteSize);
+
+	uint32_t magic = 0, count = 0, stateSize = 0;
+	uint16_t version = 0, flags = 0;
+	int32_t current = 0;
+	if (!reader.read (magic) || magic != uint32_t (kChunkMagic)) return 0;
+	if (!reader.read (version) || version > kChunkVersion) return 0;
+	reader.read (flags);
+	reader.read (count);
+	reader.read (current);
+	if (reader.failed || count > kNumPrograms) return 0;
+
+	// A preset holds exactly the current program; a bank holds at least one.
+	if ((flags & kChunkPreset) ? (count != 1) : (count == 0)) return 0;
+
+	// Decode everything before applying anything.
+	DSBeeProgram decoded[kNumPrograms];
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint8_t nameLength = 0;
+		reader.read (decoded[i].amp);
+		reader.read (decoded[i].pad_x);
+		reader.read (decoded[i].pad_y);
+		reader.read (nameLength);
+		if (const uint8_t* name = reader.readBytes (nameLength))
+			decoded[i].name.assign ((const char*) name, nameLength);
+	}
+
+	DSBeeProgram values;
+	reader.read (values.amp);
+	reader.read (values.pad_x);
+	reader.read (values.pad_y);
+
+	const uint8_t* state = reader.read (stateSize) ? reader.readBytes (stateSize) : nullptr;
+	if (reader.failed) return 0;
+
+	// Apply the programs...
+	if (flags & kChunkPreset)
+	{
+		programs[curProgram] = decoded[0];
+	}
+	else
+	{
+		for (uint32_t i = 0; i < count; ++i) programs[i] = decoded[i];
+		curProgram = std::min<VstInt32> (std::max<VstInt32> (current, 0), kNumPrograms-1);
+	}
+	program.pad_x = values.pad_x;
+	program.pad_y = values.pad_y;
+	program.amp   = values.amp;
+
+	// ... and hand parameters and processor state to the audio thread, to load between blocks.
+	publishSnapshot (state, stateSize);
+	return 1;
+}
+
+//------------------------------------------------------------------------
+void DSBeeEffect::publishSnapshot (const uint8_t* state, size_t stateSize)
+{
+	DSBeeSnapshot* snapshot = new DSBeeSnapshot;
+	snapshot->values[kAmp]  = program.amp;
+	snapshot->values[kPadX] = program.pad_x;
+	snapshot->values[kPadY] = program.pad_y;
+
+	if (state)
+	{
+		snapshot->hasState = true;
+		snapshot->state.assign (state, state + stateSize);
+	}
+
+	// Don't lose processor state from a snapshot that was never picked up.
+	if (DSBeeSnapshot* unused = snapshots.reclaim ())
+	{
+		if (unused->hasState && !snapshot->hasState)
+		{
+			snapshot->hasState = true;
+			snapshot->state.swap (unused->state);
+		}
+		delete unused;
+	}
+
+	// Older automation is superseded by the snapshot.
+	automatedMask.store (0);
+	snapshots.publish (snapshot);
+}
+
+//------------------------------------------------------------------------
+void DSBeeEffect::receiveParameters ()
+{
+	if (DSBeeSnapshot* snapshot = snapshots.receive ())
+	{
+		for (VstInt32 i = 0; i < kNumParams; ++i) target[i] = snapshot->values[i];
+
+		if (snapshot->hasState)
+		{
+			// New state replaces the processor's history, so there's nothing to glide from.
+			dsbee::StateReader reader (snapshot->state.data (), snapshot->state.size ());
+			processor->loadState (reader);
+			for (VstInt32 i = 0; i < kNumParams; ++i) live[i] = target[i];
+			fadeRemaining = 0;
+		}
+		else
+		{
+			fadeRemaining = fadeLength;
+		}
+	}
+
+	// Automated values take effect immediately.
+	if (uint32_t mask = automatedMask.exchange (0))
+	{
+		for (VstInt32 i = 0; i < kNumParams; ++i) if (mask & (1u << i))
+			live[i] = target[i] = automated[i].load (std::memory_order_relaxed);
+	}
+}
+
+//------------------------------------------------------------------------
+void DSBeeEffect::glideParameters (VstInt32 sampleFrames)
+{
+	// Glide toward a new program's values; processBuses () calls this for each short sub-block.
+	if (fadeRemaining > 0)
+	{
+		VstInt32 step = std::min (sampleFrames, fadeRemaining);
+		for (VstInt32 i = 0; i < kNumParams; ++i)
+			live[i] += (target[i] - live[i]) * float (step) / float (fadeRemaining);
+		fadeRemaining -= step;
+	}
+	else
+	{
+		for (VstInt32 i = 0; i < kNumParams; ++i) live[i] = target[i];
+	}
+}
+
 //------------------------------------------------------------------------
 void DSBeeEffect::setParameter (VstInt32 index, float value)
 {
@@ -145,7 +485,11 @@ void DSBeeEffect::setParameter (VstInt32 index, float value)
 	case kAmp  : program.amp   = value; break;
 	case kPadX : program.pad_x = value; break;
 	case kPadY : program.pad_y = value; break;
+	default    : return;
 	}
+
+	automated[index].store (value, std::memory_order_relaxed);
+	automatedMask.fetch_or (1u << index);
 }
 
 //------------------------------------------------------------------------
@@ -221,25 +565,311 @@ float MOUSE_X = 0.f, MOUSE_Y = 0.f;
 //---------------------------------------------------------------------------
 void DSBeeEffect::processReplacing (float** inputs, float** outputs, VstInt32 sampleFrames)
 {
-	float* in1 = inputs[0];
-	float* out1 = outputs[0];
-	//float* out2 = outputs[1];
+	dsbee::DenormalScope denormals;	// flush denormals to zero until we return
+
+	dsbee::Buses<float> buses =
+		{inputs, outputs, inputArrangement.numChannels, outputArrangement.numChannels, sampleFrames};
+
+	processBuses (buses);
+}
+
+//---------------------------------------------------------------------------
+void DSBeeEffect::processDoubleReplacing (double** inputs, double** outputs, VstInt32 sampleFrames)
+{
+	dsbee::DenormalScope denormals;	// flush denormals to zero until we return
 
-	MOUSE_X = program.pad_x;
-	MOUSE_Y = program.pad_y;
+	dsbee::Buses<double> buses =
+		{inputs, outputs, inputArrangement.numChannels, outputArrangement.numChannels, sampleFrames};
 
-	processor->process(in1, out1, sampleFrames);
+	processBuses (buses);
+}
+
+//---------------------------------------------------------------------------
+template<typename Sample>
+void DSBeeEffect::processBuses (const dsbee::Buses<Sample>& buses)
+{
+	VstInt32 latency = newLatency.exchange (-1);
+	if (latency >= 0)
+		reportLatency (latency);
+
+	receiveParameters ();
+
+	// While a program change glides, the graph runs in sub-blocks of kProgramFadeFrames, so the
+	//   values it sees move in small steps.  The first sub-block covers any MIDI released early,
+	//   whose offsets are relative to it.
+	const Sample* inputs[kMaxChannels];
+	Sample* outputs[kMaxChannels];
+	dsbee::Buses<Sample> part = {inputs, outputs, buses.inputCount, buses.outputCount, 0, false};
+
+	VstInt32 count = (VstInt32) buses.count;
+	for (VstInt32 done = 0; done < count; )
+	{
+		VstInt32 frames = count - done;
+		if (fadeRemaining > 0)
+			frames = std::min (frames, std::max (kProgramFadeFrames, done ? 0 : midiReleased));
+
+		glideParameters (frames);
+		releaseMidi (frames);
+		sampleClock += frames;
+
+		MOUSE_X = live[kPadX];
+		MOUSE_Y = live[kPadY];
+
+		if (frames == count)
+		{
+			processGraph (buses);
+			break;
+		}
+		for (dsbee::index_t c = 0; c < buses.inputCount; ++c)  inputs[c]  = buses.inputs[c]  + done;
+		for (dsbee::index_t c = 0; c < buses.outputCount; ++c) outputs[c] = buses.outputs[c] + done;
+		part.count = frames;
+		processGraph (part);
+		done += frames;
+	}
+	midiReleased = 0;
+
+	outputTap.feed (buses.outputs, buses.outputCount, buses.count);
+
+	sendSysEx ();
+}
+
+//---------------------------------------------------------------------------
+void DSBeeEffect::sendSysEx ()
+{
+	// Replies are copied into storage that stays valid until the next block.
+	VstInt32 count = 0;
+	ciResponder->drain ([this, &count] (const uint8_t* dump, size_t length)
+	{
+		VstMidiSysexEvent& event = sysExOutEvents[count];
+		memcpy (sysExOut[count], dump, length);
+		memset (&event, 0, sizeof (event));
+		event.type = kVstSysExType;
+		event.byteSize = sizeof (event);
+		event.dumpBytes = (VstInt32) length;
+		event.sysexDump = (char*) sysExOut[count];
+		sysExOutList.events[count++] = (VstEvent*) &event;
+	}, kMaxSysExOut);
+
+	if (count)
+	{
+		sysExOutList.numEvents = count;
+		sysExOutList.reserved = 0;
+		sendVstEventsToHost ((VstEvents*) &sysExOutList);
+	}
+}
+
+//---------------------------------------------------------------------------
+template<typename Sample>
+void DSBeeEffect::processGraph (const dsbee::Buses<Sample>& hostBuses)
+{
+	float mixTarget = bypassRequested.load (std::memory_order_relaxed) ? 0.f : 1.f;
+	bool fading = (bypassMix != mixTarget);
+
+	// Let the processor graph know when the input is silent.
+	dsbee::Buses<Sample> buses = hostBuses;
+	buses.silentInput = true;
+	for (dsbee::index_t c = 0; c < buses.inputCount && buses.silentInput; ++c)
+		buses.silentInput = dsbee::IsSilent (buses.inputs[c], buses.count);
+
+	// Idle on silent input: skip the processor entirely.
+	if (buses.silentInput && !fading && mixTarget == 1.f && processor->isIdle ())
+	{
+		if (dryLatency)
+			captureDry (buses);
+		for (dsbee::index_t c = 0; c < buses.outputCount; ++c)
+			std::fill (buses.outputs[c], buses.outputs[c] + buses.count, Sample (0));
+		return;
+	}
+
+	// Not bypassed, and no latency to track: the dry path costs nothing.
+	if (!fading && mixTarget == 1.f && dryLatency == 0)
+	{
+		processor->process (buses);
+		return;
+	}
+
+	captureDry (buses);
+
+	if (!fading)
+	{
+		if (mixTarget == 1.f)
+		{
+			processor->process (buses);
+		}
+		else
+		{
+			// Fully bypassed: the processor doesn't run at all.
+			for (dsbee::index_t c = 0; c < buses.outputCount; ++c)
+			{
+				const double* dry = dryBlock.data () + c * this->blockSize;
+				std::copy (dry, dry + buses.count, buses.outputs[c]);
+			}
+		}
+		return;
+	}
+
+	// Crossfade between the processor's output and the dry signal.
+	if (bypassMix == 0.f)
+		processor->setBypass (false);
+
+	processor->process (buses);
+
+	float step = (mixTarget > bypassMix) ? bypassStep : -bypassStep, mix = bypassMix;
+	for (dsbee::index_t c = 0; c < buses.outputCount; ++c)
+	{
+		const double* dry = dryBlock.data () + c * this->blockSize;
+		Sample* out = buses.outputs[c];
+		mix = bypassMix;
+		for (dsbee::index_t i = 0; i < buses.count; ++i)
+		{
+			mix = std::min (1.f, std::max (0.f, mix + step));
+			out[i] = Sample (dry[i] + (out[i] - dry[i]) * mix);
+		}
+	}
+	bypassMix = mix;
+
+	if (bypassMix == 0.f)
+		processor->setBypass (true);
+}
 
-	/*while (--sampleFrames >= 0)
+//---------------------------------------------------------------------------
+template<typename Sample>
+void DSBeeEffect::captureDry (const dsbee::Buses<Sample>& buses)
+{
+	// Copy the input before the processor can overwrite it, delayed by the processor's latency.
+	//   Outputs beyond the inputs reuse the last input; a synth's dry signal is silence.
+	VstInt32 cursor = dryCursor;
+	for (dsbee::index_t c = 0; c < buses.outputCount; ++c)
+	{
+		double* dry = dryBlock.data () + c * this->blockSize;
+		double* delay = dryDelay.data () + c * dryLatency;
+		const Sample* in = buses.inputCount ? buses.inputs[std::min (c, buses.inputCount - 1)] : nullptr;
+
+		cursor = dryCursor;
+		for (dsbee::index_t i = 0; i < buses.count; ++i)
+		{
+			double x = in ? double (in[i]) : 0.0;
+			if (dryLatency)
+			{
+				dry[i] = delay[cursor];
+				delay[cursor] = x;
+				if (++cursor >= dryLatency) cursor = 0;
+			}
+			else dry[i] = x;
+		}
+	}
+	dryCursor = cursor;
+}
+
+//---------------------------------------------------------------------------
+void DSBeeEffect::replaceProcessor (dsbee::Processor* next)
+{
+	// The channel layout was fixed at construction; the new graph runs at that width.
+	processor->replace (next);
+	noteLatency ();
+}
+
+//---------------------------------------------------------------------------
+void DSBeeEffect::noteLatency ()
+{
+	// Hot reloads call this from the watcher thread; the host hears about it from processBuses ().
+	newLatency = (VstInt32) processor->latency ();
+}
+
+//---------------------------------------------------------------------------
+void DSBeeEffect::reportLatency (VstInt32 latency)
+{
+	// Tell the host when the processor's latency changes, so it can re-align its delay compensation.
+	//   The dry path for bypass follows on the next resume (), which hosts call after ioChanged.
+	if (latency == cEffect.initialDelay)
+		return;
+
+	setInitialDelay (latency);
+	ioChanged ();
+}
+
+//---------------------------------------------------------------------------
+VstInt32 DSBeeEffect::getGetTailSize ()
+{
+	// 1 means "no tail"; 0 leaves it to the host, for processors that can sound indefinitely.
+	dsbee::index_t tail = processor->tailLength ();
+	if (tail == dsbee::Processor::TAIL_NONE)    return 1;
+	if (tail == dsbee::Processor::TAIL_UNKNOWN) return 0;
+	return (VstInt32) std::min<dsbee::index_t> (tail + processor->latency (), 0x7FFFFFFF);
+}
+
+//------------------------------------------------------------------------
+VstIntPtr DSBeeEffect::vendorSpecific (VstInt32 lArg, VstIntPtr lArg2, void* ptrArg, float floatArg)
+{
+	if (lArg != kTapVendorId || !ptrArg)
+		return 0;
+
+	switch (lArg2)
 	{
-		float x = *in++;
-		buffer[cursor++] = x + y * fFeedBack;
-		if (cursor >= delay)
-			cursor = 0;
-		*out1++ = y;
-		if (out2)
-			*out2++ = y;
-	}*/
+	case kTapSubscribe:
+		outputTap.subscribe (*(const unsigned*) ptrArg);
+		return 1;
+	case kTapUnsubscribe:
+		outputTap.unsubscribe (*(const unsigned*) ptrArg);
+		return 1;
+	case kTapReadMeter:
+		return outputTap.readMeter (*(dsbee::Tap::Meter*) ptrArg) ? 1 : 0;
+	case kTapReadScope:
+		{
+			DSBeeTapBuffer* buffer = (DSBeeTapBuffer*) ptrArg;
+			if (!buffer->samples || buffer->count <= 0)
+				return 0;
+			return (VstIntPtr) outputTap.readScope (buffer->samples, (size_t) buffer->count);
+		}
+	case kTapReadSpectrum:
+		return outputTap.readSpectrum ((float*) ptrArg) ? 1 : 0;
+	}
+	return 0;
+}
+
+//---------------------------------------------------------------------------
+bool DSBeeEffect::setBypass (bool onOff)
+{
+	// May be called from the audio thread; the crossfade starts on the next block.
+	bypassRequested.store (onOff, std::memory_order_relaxed);
+	return true;
+}
+
+//---------------------------------------------------------------------------
+bool DSBeeEffect::setProcessPrecision (VstInt32 precision)
+{
+	// Both precisions are supported; processors which don't override
+	//   the double overload run their float inner loop in mixed mode.
+	return precision == kVstProcessPrecision32 || precision == kVstProcessPrecision64;
+}
+
+//---------------------------------------------------------------------------
+bool DSBeeEffect::setSpeakerArrangement (VstSpeakerArrangement* pluginInput, VstSpeakerArrangement* pluginOutput)
+{
+	// Accept any layout that fits within the processor's channels.
+	if (!pluginInput || !pluginOutput)
+		return false;
+	if (pluginInput->numChannels < 0 || pluginInput->numChannels > cEffect.numInputs)
+		return false;
+	if (pluginOutput->numChannels < 1 || pluginOutput->numChannels > cEffect.numOutputs)
+		return false;
+
+	inputArrangement.type = pluginInput->type;
+	inputArrangement.numChannels = pluginInput->numChannels;
+	memcpy (inputArrangement.speakers, pluginInput->speakers, pluginInput->numChannels * sizeof (VstSpeakerProperties));
+
+	outputArrangement.type = pluginOutput->type;
+	outputArrangement.numChannels = pluginOutput->numChannels;
+	memcpy (outputArrangement.speakers, pluginOutput->speakers, pluginOutput->numChannels * sizeof (VstSpeakerProperties));
+	return true;
+}
+
+//---------------------------------------------------------------------------
+bool DSBeeEffect::getSpeakerArrangement (VstSpeakerArrangement** pluginInput, VstSpeakerArrangement** pluginOutput)
+{
+	*pluginInput = &inputArrangement;
+	*pluginOutput = &outputArrangement;
+	return true;
 }
 
 AudioEffect* createEffectInstance (audioMasterCallback audioMaster)
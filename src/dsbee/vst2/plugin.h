@@ -1,9 +1,19 @@
 #pragma once
 
 
+#include <atomic>
 #include <string>
+#include <vector>
 
+#include <dsbee/ci_responder.h>
 #include <dsbee/dsbee.h>
+#include <dsbee/handoff.h>
+#include <dsbee/hot_swap.h>
+#include <dsbee/hot_reload.h>
+#include <dsbee/midi_scheduler.h>
+#include <dsbee/tap.h>
+#include <plaid_midi2/jr_timestamps.h>
+#include <plaid_midi2/midi1_translator.h>
 
 #include "public.sdk/source/vst2.x/audioeffectx.h"
 
@@ -17,11 +27,53 @@ enum
 	kPadX = 1,
 	kPadY = 2,
 
-	kNumParams
+	kNumParams,
+
+	// I/O
+	kMaxChannels = 8, // VstSpeakerArrangement holds up to 8 speakers
+	kMaxSysExOut = 4, // MIDI-CI replies sent to the host per block
+	kMidiInWords = 1024, // UMP words translated from one event list before delivery
+
+	// Chunk format
+	kChunkMagic   = 'DSBc',
+	kChunkVersion = 1,
+	kChunkPreset  = 0x0001, // Chunk flags: holds only the current program
+};
+
+//------------------------------------------------------------------------
+// The output tap, for hosts that only see the VST2 ABI: dispatch effVendorSpecific
+// with index = kTapVendorId, value = one of these opcodes and ptr = its argument.
+// Call from a single UI thread.
+enum DSBeeTapOpcode
+{
+	kTapVendorId = 'DSBt',
+
+	kTapSubscribe = 1,   // ptr: const unsigned* -- dsbee::Tap::FEATURE flags to start
+	kTapUnsubscribe,     // ptr: const unsigned* -- flags to stop
+	kTapReadMeter,       // ptr: dsbee::Tap::Meter*; returns 1 if a new reading was read
+	kTapReadScope,       // ptr: DSBeeTapBuffer*; returns the number of samples read
+	kTapReadSpectrum,    // ptr: float[dsbee::Tap::SPECTRUM_SIZE / 2]; returns 1 if a new spectrum was read
+};
+
+struct DSBeeTapBuffer
+{
+	float* samples;
+	VstInt32 count;
 };
 
 class DSBeeEffect;
 
+//------------------------------------------------------------------------
+// A complete set of parameter values (and optionally processor state),
+// prepared off the audio thread and published to it in a single swap.
+struct DSBeeSnapshot
+{
+	float values[kNumParams];
+
+	bool hasState = false;
+	std::vector<uint8_t> state;
+};
+
 //------------------------------------------------------------------------
 class DSBeeProgram
 {
@@ -51,12 +103,23 @@ public:
 
 	//---from AudioEffect-----------------------
 	virtual void processReplacing (float** inputs, float** outputs, VstInt32 sampleFrames);
+	virtual void processDoubleReplacing (double** inputs, double** outputs, VstInt32 sampleFrames);
+
+	virtual bool setProcessPrecision (VstInt32 precision);
+
+	virtual bool setBypass (bool onOff);
+
+	virtual bool setSpeakerArrangement (VstSpeakerArrangement* pluginInput, VstSpeakerArrangement* pluginOutput);
+	virtual bool getSpeakerArrangement (VstSpeakerArrangement** pluginInput, VstSpeakerArrangement** pluginOutput);
 
 	virtual void setProgram (VstInt32 program);
 	virtual void setProgramName (char* name);
 	virtual void getProgramName (char* name);
 	virtual bool getProgramNameIndexed (VstInt32 category, VstInt32 index, char* text);
 
+	virtual VstInt32 getChunk (void** data, bool isPreset = false);
+	virtual VstInt32 setChunk (void* data, VstInt32 byteSize, bool isPreset = false);
+
 	virtual void setParameter (VstInt32 index, float value);
 	virtual float getParameter (VstInt32 index);
 	virtual void getParameterLabel (VstInt32 index, char* label);
@@ -71,20 +134,93 @@ public:
 	virtual VstInt32 getVendorVersion () { return 1000; }
 
 	virtual VstPlugCategory getPlugCategory () { return kPlugCategEffect; }
+	virtual VstInt32 getGetTailSize ();
+
+	virtual VstIntPtr vendorSpecific (VstInt32 lArg, VstIntPtr lArg2, void* ptrArg, float floatArg);
+
+	// Replace the processor graph while audio runs.  Call from any thread but the audio thread;
+	//   the new graph is started here and crossfaded in.  Takes ownership of the processor.
+	void replaceProcessor (dsbee::Processor* next);
+
+	// Meters, scope and spectrum of the plugin's output, for code linked with the plugin.
+	//   Hosts reach the same tap through vendorSpecific (see DSBeeTapOpcode).
+	dsbee::Tap& getOutputTap () { return outputTap; }
 
 protected:
-	//void setDelay (float delay);
+	void noteLatency ();
+	void reportLatency (VstInt32 latency);
+	void writeChunk (dsbee::StateWriter& writer, bool isPreset);
+	void publishSnapshot (const uint8_t* state = nullptr, size_t stateSize = 0);
+	void receiveParameters ();
+	void glideParameters (VstInt32 sampleFrames);
+	void sendSysEx ();
+	void deliverMidi (midi2::UMP_StreamWriter& pending, VstInt32 deltaFrames);
+	void releaseMidi (VstInt32 frames);
+
+	template<typename Sample> void processBuses (const dsbee::Buses<Sample>& buses);
+	template<typename Sample> void processGraph (const dsbee::Buses<Sample>& buses);
+	template<typename Sample> void captureDry (const dsbee::Buses<Sample>& buses);
 
 	DSBeeProgram* programs;
 	VstInt32 program_count;
 
-	float* buffer;
-
 	DSBeeProgram program;
 
-	dsbee::Processor *processor;
-
-	//long delay;
-	//long size;
-	//long cursor;
+	dsbee::HotSwap *processor;
+	dsbee::HotReload *reloader;   // watches DSBEE_RELOAD, if set
+
+	// Latency noted off the audio thread, reported to the host with the next block; -1 if unchanged.
+	std::atomic<VstInt32> newLatency;
+
+	std::vector<uint8_t> chunk;   // storage for getChunk
+
+	// Program changes and chunks arrive as snapshots; automation as single values.
+	dsbee::Handoff<DSBeeSnapshot> snapshots;
+	std::atomic<float> automated[kNumParams];
+	std::atomic<uint32_t> automatedMask;
+
+	// Parameter values on the audio thread, fading toward target after a program change.
+	float live[kNumParams];
+	float target[kNumParams];
+	VstInt32 fadeLength;
+	VstInt32 fadeRemaining;
+
+	// Soft bypass: the dry signal is delayed to line up with the processor's latency.
+	std::atomic<bool> bypassRequested;
+	float bypassMix;               // 1 = processing, 0 = bypassed
+	float bypassStep;              // per-sample crossfade increment
+	VstInt32 dryLatency;
+	VstInt32 dryCursor;
+	std::vector<double> dryDelay;  // dryLatency samples per output channel
+	std::vector<double> dryBlock;  // one block per output channel
+
+	dsbee::Tap outputTap;
+
+	// SysEx from the host, reassembled without allocating on the audio thread.
+	midi2::SysEx_Assembler sysExInput;
+
+	// MIDI from the host, translated to UMP (keeping running status per group) a whole event list at a time.
+	midi2::Midi1_To_UMP midiInput;
+	midi2::UMP::word_t midiInWords[kMidiInWords];
+
+	// MIDI waits here until the block it falls in; JR timestamps (from UMP sources) place it precisely.
+	dsbee::MidiScheduler midiSchedule;
+	midi2::JR_Timing jrTiming;
+	int64_t sampleClock;           // samples processed since resume
+	VstInt32 midiReleased;         // samples of the coming block whose MIDI processEvents () released early
+
+	// MIDI-CI is answered on the responder's own thread; replies go out from the audio thread.
+	dsbee::CI_Responder* ciResponder;
+	struct
+	{
+		VstInt32 numEvents;
+		VstIntPtr reserved;
+		VstEvent* events[kMaxSysExOut];
+	} sysExOutList;
+	VstMidiSysexEvent sysExOutEvents[kMaxSysExOut];
+	uint8_t sysExOut[kMaxSysExOut][dsbee::CI_Responder::MAX_MESSAGE + 2];
+
+	// Active channel layout, negotiated with the host.
+	VstSpeakerArrangement inputArrangement;
+	VstSpeakerArrangement outputArrangement;
 };
\ No newline at end of file
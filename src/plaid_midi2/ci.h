@@ -1,6 +1,9 @@
 #pragma once
 
 
+#include <cstring>
+
+#include "midi2.h"
 #include "universal_sysex.h"
 
 
@@ -67,6 +70,120 @@ namespace midi2
 		// Read & write
 		bool read (SysEx_Reader &reader)          {return reader >> sysExId >> family >> model >> revision;}
 		bool write(SysEx_Writer &writer) const    {return writer << sysExId << family << model << revision;}
+
+		enum { BYTE_SIZE = 11 };
+	};
+
+	/*
+		Fixed-size byte strings used in MIDI-CI messages.
+			These work as SysEx fields, and arrays of them have the same layout as the message bytes.
+	*/
+	template<size_t N>
+	struct CI_Bytes_
+	{
+	public:
+		static const size_t BYTE_SIZE = N;
+		static const bool   IS_7_BIT  = true;
+
+		uint8_t bytes[N];
+
+	public:
+		bool operator==(const CI_Bytes_ &o) const    {return std::memcmp(bytes, o.bytes, N) == 0;}
+		bool operator!=(const CI_Bytes_ &o) const    {return std::memcmp(bytes, o.bytes, N) != 0;}
+
+		bool valid() const    {return sysex::Find_High_Bit(bytes, bytes + N) == bytes + N;}
+
+		bool read_noByteCheck(const uint8_t *data)    {std::memcpy(bytes, data, N); return true;}
+		bool write           (uint8_t *data) const    {std::memcpy(data, bytes, N); return valid();}
+	};
+
+	/*
+		Profile ID:  standard profiles begin with 0x7E, others with a manufacturer's SysEx ID.
+	*/
+	struct CI_ProfileId : public CI_Bytes_<5>
+	{
+	public:
+		CI_ProfileId()    : CI_Bytes_<5>{{0x7E, 0, 0, 0, 0}} {}
+		CI_ProfileId(uint8_t b0, uint8_t b1, uint8_t b2, uint8_t b3, uint8_t b4)    : CI_Bytes_<5>{{b0, b1, b2, b3, b4}} {}
+
+		bool standard() const    {return bytes[0] == 0x7E;}
+	};
+
+	/*
+		A protocol, as listed in protocol negotiation:  type, version, extensions and two reserved bytes.
+	*/
+	struct CI_Protocol : public CI_Bytes_<5>
+	{
+	public:
+		CI_Protocol()                                   : CI_Bytes_<5>{{0, 0, 0, 0, 0}} {}
+		CI_Protocol(const UMP::Protocol &protocol)      : CI_Bytes_<5>{{protocol.type, protocol.version, protocol.extensions, 0, 0}} {}
+
+		UMP::Protocol protocol() const    {return UMP::Protocol(UMP::Protocol::PROTOCOL_TYPE(bytes[0]), bytes[1], bytes[2]);}
+	};
+
+	/*
+		A counted list of entries, pointing into a message.
+				Count -- SysEx field type for the number of entries
+				Entry -- entry type (CI_ProfileId or CI_Protocol)
+			Parsing points the list into the source message;  for writing, point it at an array of entries.
+	*/
+	template<typename Count, typename Entry>
+	struct CI_List
+	{
+	public:
+		const uint8_t *bytes = nullptr;
+		uint32_t       count = 0;
+
+	public:
+		CI_List() {}
+		CI_List(const Entry *entries, uint32_t _count)    : bytes(entries ? entries->bytes : nullptr), count(_count) {}
+
+		Entry operator[](size_t i) const    {Entry e; e.read_noByteCheck(bytes + i * Entry::BYTE_SIZE); return e;}
+
+		size_t size() const    {return Count::BYTE_SIZE + count * Entry::BYTE_SIZE;}
+
+		// Read & write
+		bool read(SysEx_Reader &reader)
+		{
+			Count n = 0;
+			if (!reader.read(n)) return false;
+			count = n;
+			return (bytes = reader.read7(count * Entry::BYTE_SIZE)) != nullptr;
+		}
+		bool write(SysEx_Writer &writer) const
+		{
+			return (writer << Count(count)) && writer.write7(bytes, count * Entry::BYTE_SIZE);
+		}
+	};
+
+	/*
+		Variable-length data, pointing into a message, with its length as a SysEx field.
+	*/
+	template<typename Length>
+	struct CI_Data
+	{
+	public:
+		const uint8_t *bytes  = nullptr;
+		uint32_t       length = 0;
+
+	public:
+		CI_Data() {}
+		CI_Data(const uint8_t *_bytes, uint32_t _length)    : bytes(_bytes), length(_length) {}
+
+		size_t size() const    {return Length::BYTE_SIZE + length;}
+
+		// Read & write
+		bool read(SysEx_Reader &reader)
+		{
+			Length n = 0;
+			if (!reader.read(n)) return false;
+			length = n;
+			return (bytes = reader.read7(length)) != nullptr;
+		}
+		bool write(SysEx_Writer &writer) const
+		{
+			return (writer << Length(length)) && writer.write7(bytes, length);
+		}
 	};
 
 	/*
@@ -119,12 +236,15 @@ namespace midi2
 
 			MGMT_DISCOVERY       = 0x70,
 			MGMT_DISCOVERY_REPLY = 0x71,
-			MGMT_INVALIDATE      = 0x72,
+			MGMT_INVALIDATE      = 0x7E,
 			MGMT_NAK             = 0x7F,
 		};
 
+		// Size in bytes of the header common to all MIDI-CI messages (not including F0).
+		enum { HEADER_SIZE = 13 };
+
 	public:
-		/*	
+		/*
 			Every MIDI-CI message includes a source and destination MUID.
 		*/
 		struct Addressing
@@ -143,12 +263,16 @@ namespace midi2
 			bool valid() const    {return source.valid() && destination.valid();}
 
 			// Read & write
-			bool read (SysEx_Reader &reader)          {return (reader >> source.value >> destination.value) && valid();}
-			bool write(SysEx_Writer &writer) const    {return (writer << source.value << destination.value);}
+			bool read (SysEx_Reader &reader)          {return (reader >> source >> destination) && valid();}
+			bool write(SysEx_Writer &writer) const    {return (writer << source << destination);}
 		};
 
 		/*
 			Base type for MIDI-CI messages.
+				Subclasses add a body, and provide:
+					read_body / write_body -- the part after the common header
+					body_size              -- its size in bytes
+				read, write and size cover the whole message (without F0 and F7).
 		*/
 		struct Base : public UniversalSysEx::Base
 		{
@@ -189,76 +313,347 @@ namespace midi2
 			// Read & write
 			bool read (SysEx_Reader &reader);
 			bool write(SysEx_Writer &writer) const;
+
+			bool   read_body (SysEx_Reader &reader)          {return true;}
+			bool   write_body(SysEx_Writer &writer) const    {return true;}
+			size_t body_size ()                     const    {return 0;}
+		};
+
+		/*
+			Adds whole-message read, write and size to a message type with a body.
+		*/
+		template<typename Message>
+		struct Body_ : public Base
+		{
+		public:
+			using Base::Base;
+
+			bool   read (SysEx_Reader &reader)          {return Base::read (reader) && self().read_body (reader) && self().valid();}
+			bool   write(SysEx_Writer &writer) const    {return Base::write(writer) && self().write_body(writer);}
+			size_t size ()                     const    {return HEADER_SIZE + self().body_size();}
+
+		private:
+			Message       &self()          {return static_cast<Message&>(*this);}
+			const Message &self() const    {return static_cast<const Message&>(*this);}
 		};
 
 		/*
 			NAK message.
 		*/
-		struct NAK : public Base
+		struct NAK : public Body_<NAK>
 		{
 		public:
 			NAK() {}
-			NAK(UInt7 ci_channel, MUID source, MUID desination)    : Base(MGMT_NAK, ci_channel, source, desination) {}
+			NAK(UInt7 ci_channel, MUID source, MUID desination)    : Body_(MGMT_NAK, ci_channel, source, desination) {}
 
 			bool valid() const    {return Base::valid() && ci_type() == MGMT_NAK;}
-
-			using Base::read;
-			using Base::write;
 		};
 
 		/*
 			Discovery or Reply to Discovery message.
 		*/
-		struct Discovery : public Base
+		struct Discovery : public Body_<Discovery>
 		{
 		public:
+			enum CAPABILITY
+			{
+				CAN_PROTOCOL = 0x02,
+				CAN_PROFILE  = 0x04,
+				CAN_PROPERTY = 0x08,
+			};
+
 			CI_Identity identity;
+			UInt7       capabilities   = 0;  // CAPABILITY flags
+			UInt28      max_sysex_size = 0;  // Largest SysEx message the sender can receive
 
 		public:
+			Discovery() {}
 			Discovery(bool is_reply, MUID source, MUID desination, CI_Identity _identity) :
-				Base(is_reply ? MGMT_DISCOVERY_REPLY : MGMT_DISCOVERY, CI_CHANNEL_ALL, source, desination),
+				Body_(is_reply ? MGMT_DISCOVERY_REPLY : MGMT_DISCOVERY, CI_CHANNEL_ALL, source, desination),
 				identity(_identity) {}
 
+			bool is_reply() const    {return ci_type() == MGMT_DISCOVERY_REPLY;}
+
 			bool valid() const    {return Base::valid() && ci_channel() == CI_CHANNEL_ALL && identity.valid();}
 
-			using Base::read;
-			using Base::write;
+			bool   read_body (SysEx_Reader &reader)          {return identity.read (reader) && (reader >> capabilities >> max_sysex_size);}
+			bool   write_body(SysEx_Writer &writer) const    {return identity.write(writer) && (writer << capabilities << max_sysex_size);}
+			size_t body_size ()                     const    {return CI_Identity::BYTE_SIZE + 1 + 4;}
+		};
+
+		/*
+			Invalidate MUID:  the target MUID should no longer be used.
+		*/
+		struct InvalidateMUID : public Body_<InvalidateMUID>
+		{
+		public:
+			MUID target;
+
+		public:
+			InvalidateMUID() {}
+			InvalidateMUID(MUID source, MUID _target)    : Body_(MGMT_INVALIDATE, CI_CHANNEL_ALL, source, MUID::Broadcast()), target(_target) {}
+
+			bool valid() const    {return Base::valid() && target.valid();}
+
+			bool   read_body (SysEx_Reader &reader)          {return reader >> target;}
+			bool   write_body(SysEx_Writer &writer) const    {return writer << target;}
+			size_t body_size ()                     const    {return 4;}
 		};
 
 		/*
 			Protocol negotiation messages always include an authority level...
+				PROT_CONFIRM has nothing else.
 		*/
-		struct ProtocolNegotiation : public Base
+		template<typename Message>
+		struct Negotiation_ : public Body_<Message>
 		{
 		public:
 			sysex::UInt7 authority_level = 0xFF;
 
 		public:
-			bool valid() const                        {return Base::valid() && authority_level.valid();}
+			Negotiation_() {}
+			Negotiation_(UInt7 ci_type, MUID source, MUID destination, UInt7 authority) :
+				Body_<Message>(ci_type, CI_CHANNEL_ALL, source, destination), authority_level(authority) {}
 
-			// Read & write
-			bool read (SysEx_Reader &reader)          {return Base::read (reader) & (reader >> authority_level);}
-			bool write(SysEx_Writer &writer) const    {return Base::write(writer) & (writer << authority_level);}
+			bool valid() const    {return Base::valid() && authority_level.valid();}
+
+			bool   read_body (SysEx_Reader &reader)          {return reader >> authority_level;}
+			bool   write_body(SysEx_Writer &writer) const    {return writer << authority_level;}
+			size_t body_size ()                     const    {return 1;}
 		};
 
+		struct ProtocolNegotiation : public Negotiation_<ProtocolNegotiation>
+		{
+		public:
+			using Negotiation_::Negotiation_;
+			ProtocolNegotiation() {}
+		};
 
 		/*
-			Prope
+			Initiate Protocol Negotiation (PROT_INIT) and its reply:  the protocols supported, in order of preference.
 		*/
-		struct PropertyChunk : public Base
+		struct ProtocolInit : public Negotiation_<ProtocolInit>
 		{
 		public:
-			sysex::UInt7 authority_level = 0xFF;
+			CI_List<UInt7, CI_Protocol> protocols;
 
 		public:
-			bool valid() const                        {return Base::valid() && authority_level.valid();}
+			using Negotiation_::Negotiation_;
+			ProtocolInit() {}
 
-			// Read & write
-			bool read (SysEx_Reader &reader)          {return Base::read (reader) & (reader >> authority_level);}
-			bool write(SysEx_Writer &writer) const    {return Base::write(writer) & (writer << authority_level);}
+			bool   read_body (SysEx_Reader &reader)          {return Negotiation_::read_body (reader) && protocols.read (reader);}
+			bool   write_body(SysEx_Writer &writer) const    {return Negotiation_::write_body(writer) && protocols.write(writer);}
+			size_t body_size ()                     const    {return Negotiation_::body_size() + protocols.size();}
+		};
+
+		/*
+			Set New Protocol.
+		*/
+		struct ProtocolSet : public Negotiation_<ProtocolSet>
+		{
+		public:
+			CI_Protocol protocol;
+
+		public:
+			using Negotiation_::Negotiation_;
+			ProtocolSet() {}
+
+			bool   read_body (SysEx_Reader &reader)          {return Negotiation_::read_body (reader) && (reader >> protocol);}
+			bool   write_body(SysEx_Writer &writer) const    {return Negotiation_::write_body(writer) && (writer << protocol);}
+			size_t body_size ()                     const    {return Negotiation_::body_size() + CI_Protocol::BYTE_SIZE;}
+		};
+
+		/*
+			Test New Protocol, in either direction:  48 bytes counting up from 0.
+		*/
+		struct ProtocolTest : public Negotiation_<ProtocolTest>
+		{
+		public:
+			enum { TEST_SIZE = 48 };
+
+			bool test_passed = true;  // Whether the test data arrived intact
+
+		public:
+			using Negotiation_::Negotiation_;
+			ProtocolTest() {}
+
+			bool read_body(SysEx_Reader &reader)
+			{
+				const uint8_t *data = Negotiation_::read_body(reader) ? reader.read<TEST_SIZE>() : nullptr;
+				test_passed = (data != nullptr);
+				for (uint8_t i = 0; test_passed && i < TEST_SIZE; ++i) test_passed = (data[i] == i);
+				return data != nullptr;
+			}
+			bool write_body(SysEx_Writer &writer) const
+			{
+				uint8_t *data = Negotiation_::write_body(writer) ? writer.writebuf<TEST_SIZE>() : nullptr;
+				for (uint8_t i = 0; data && i < TEST_SIZE; ++i) data[i] = i;
+				return data != nullptr;
+			}
+			size_t body_size() const    {return Negotiation_::body_size() + TEST_SIZE;}
+		};
+
+		/*
+			Profile Inquiry Reply:  lists of enabled and disabled profiles.
+		*/
+		struct ProfileInquiryReply : public Body_<ProfileInquiryReply>
+		{
+		public:
+			CI_List<UInt14, CI_ProfileId> enabled, disabled;
+
+		public:
+			using Body_::Body_;
+			ProfileInquiryReply() {}
+
+			bool   read_body (SysEx_Reader &reader)          {return enabled.read (reader) && disabled.read (reader);}
+			bool   write_body(SysEx_Writer &writer) const    {return enabled.write(writer) && disabled.write(writer);}
+			size_t body_size ()                     const    {return enabled.size() + disabled.size();}
+		};
+
+		/*
+			Messages about one profile:  Set Profile On/Off, Profile Enabled/Disabled Report.
+		*/
+		struct Profile : public Body_<Profile>
+		{
+		public:
+			CI_ProfileId profile;
+
+		public:
+			Profile() {}
+			Profile(UInt7 ci_type, UInt7 ci_channel, MUID source, MUID destination, CI_ProfileId _profile) :
+				Body_(ci_type, ci_channel, source, destination), profile(_profile) {}
+
+			bool   read_body (SysEx_Reader &reader)          {return reader >> profile;}
+			bool   write_body(SysEx_Writer &writer) const    {return writer << profile;}
+			size_t body_size ()                     const    {return CI_ProfileId::BYTE_SIZE;}
+		};
+
+		/*
+			Profile Specific Data.
+		*/
+		struct ProfileSpecific : public Body_<ProfileSpecific>
+		{
+		public:
+			CI_ProfileId    profile;
+			CI_Data<UInt28> data;
+
+		public:
+			using Body_::Body_;
+			ProfileSpecific() {}
+
+			bool   read_body (SysEx_Reader &reader)          {return (reader >> profile) && data.read (reader);}
+			bool   write_body(SysEx_Writer &writer) const    {return (writer << profile) && data.write(writer);}
+			size_t body_size ()                     const    {return CI_ProfileId::BYTE_SIZE + data.size();}
+		};
+
+		/*
+			Property Exchange Capabilities inquiry and reply.
+		*/
+		struct PropertyCaps : public Body_<PropertyCaps>
+		{
+		public:
+			UInt7 simultaneous_requests = 1;
+
+		public:
+			using Body_::Body_;
+			PropertyCaps() {}
+
+			bool   read_body (SysEx_Reader &reader)          {return reader >> simultaneous_requests;}
+			bool   write_body(SysEx_Writer &writer) const    {return writer << simultaneous_requests;}
+			size_t body_size ()                     const    {return 1;}
+		};
+
+		/*
+			Property Exchange data messages (Has/Get/Set, Subscription, Notify and their replies):
+				a JSON header and one chunk of property data.
+		*/
+		struct PropertyChunk : public Body_<PropertyChunk>
+		{
+		public:
+			UInt7           request_id  = 0;
+			CI_Data<UInt14> header;
+			UInt14          chunk_count = 1;  // 0 if unknown
+			UInt14          chunk_index = 1;  // From 1
+			CI_Data<UInt14> data;
+
+		public:
+			using Body_::Body_;
+			PropertyChunk() {}
+
+			bool last_chunk() const    {return chunk_index == chunk_count;}
+
+			bool   read_body (SysEx_Reader &reader)          {return (reader >> request_id) && header.read (reader) && (reader >> chunk_count >> chunk_index) && data.read (reader);}
+			bool   write_body(SysEx_Writer &writer) const    {return (writer << request_id) && header.write(writer) && (writer << chunk_count << chunk_index) && data.write(writer);}
+			size_t body_size ()                     const    {return 1 + header.size() + 2 + 2 + data.size();}
+		};
+	};
+
+
+	/*
+		Receives parsed MIDI-CI messages.  Override the methods for the messages of interest.
+
+			receive() reads the common header, then dispatches through a table indexed by
+			the message type.  Parsed messages point into the original message bytes,
+			which are only valid during the call.
+	*/
+	class CI_Handler
+	{
+	public:
+		using M = CI_Message;
+
+	public:
+		virtual ~CI_Handler() {}
+
+		/*
+			Parse and dispatch a MIDI-CI message (without F0 and F7).
+				Returns false if it isn't MIDI-CI, or is malformed.
+		*/
+		bool receive(const SysEx_Message &message);
+
+	public:
+		// Management
+		virtual void on_discovery      (const M::Discovery           &m)    {}
+		virtual void on_invalidate     (const M::InvalidateMUID      &m)    {}
+		virtual void on_nak            (const M::NAK                 &m)    {}
+
+		// Protocol negotiation
+		virtual void on_protocol_init  (const M::ProtocolInit        &m)    {}  // PROT_INIT, PROT_INIT_REPLY
+		virtual void on_protocol_set   (const M::ProtocolSet         &m)    {}
+		virtual void on_protocol_test  (const M::ProtocolTest        &m)    {}  // PROT_TEST_I2R, PROT_TEST_R2I
+		virtual void on_protocol_confirm(const M::ProtocolNegotiation &m)   {}
+
+		// Profile configuration
+		virtual void on_profile_inquiry(const M::Base                &m)    {}
+		virtual void on_profile_reply  (const M::ProfileInquiryReply &m)    {}
+		virtual void on_profile        (const M::Profile             &m)    {}  // PROF_SET_ON/OFF, PROF_ENABLED/DISABLED
+		virtual void on_profile_data   (const M::ProfileSpecific     &m)    {}
+
+		// Property exchange
+		virtual void on_property_caps  (const M::PropertyCaps        &m)    {}  // PROP_CAPS_INQUIRY, PROP_CAPS_REPLY
+		virtual void on_property       (const M::PropertyChunk       &m)    {}  // Other PROP_ types
+
+		// Valid header with a message type this handler doesn't parse.  reader is positioned after the header.
+		virtual void on_other          (const M::Base &m, SysEx_Reader &reader)    {}
+
+	private:
+		using Parser = bool (*)(CI_Handler&, const M::Base&, SysEx_Reader&);
+
+		template<typename Message, void (CI_Handler::*Callback)(const Message&)>
+		static bool Parse(CI_Handler &handler, const M::Base &base, SysEx_Reader &reader)
+		{
+			Message message;
+			static_cast<M::Base&>(message) = base;
+			if (!message.read_body(reader) || !message.valid()) return false;
+			(handler.*Callback)(message);
+			return true;
+		}
+
+		struct Table
+		{
+			Parser parsers[128];
+			Table();
 		};
 	};
-	
 }
 
 /*
@@ -290,11 +685,12 @@ namespace midi2
 
 	inline bool CI_Message::Base::valid() const
 	{
+		// Newer message versions extend older ones, so they are accepted;  extra bytes are ignored.
 		return UniversalSysEx::Base::valid()
 			&& sysExId == sysex::SYSEX_ID_UNIVERSAL
 			&& subId1  == sysex::SYSEX_SUBID1_MIDI_CI
 			&& (this->deviceId < 16 || this->deviceId == CI_CHANNEL_ALL)
-			&& ci_version == CI_VERSION_IMPL //.valid()  // TODO specs are unclear about what to do here
+			&& ci_version >= CI_VERSION_IMPL && ci_version.valid()
 			&& addressing.valid();
 	}
 
@@ -313,4 +709,52 @@ namespace midi2
 			&  (writer << ci_version)
 			&  addressing.write(writer);
 	}
+
+
+	inline CI_Handler::Table::Table()
+	{
+		for (Parser &p : parsers) p = nullptr;
+
+		parsers[M::MGMT_DISCOVERY]       = &Parse<M::Discovery,           &CI_Handler::on_discovery>;
+		parsers[M::MGMT_DISCOVERY_REPLY] = &Parse<M::Discovery,           &CI_Handler::on_discovery>;
+		parsers[M::MGMT_INVALIDATE]      = &Parse<M::InvalidateMUID,      &CI_Handler::on_invalidate>;
+		parsers[M::MGMT_NAK]             = &Parse<M::NAK,                 &CI_Handler::on_nak>;
+
+		parsers[M::PROT_INIT]            = &Parse<M::ProtocolInit,        &CI_Handler::on_protocol_init>;
+		parsers[M::PROT_INIT_REPLY]      = &Parse<M::ProtocolInit,        &CI_Handler::on_protocol_init>;
+		parsers[M::PROT_SET]             = &Parse<M::ProtocolSet,         &CI_Handler::on_protocol_set>;
+		parsers[M::PROT_TEST_I2R]        = &Parse<M::ProtocolTest,        &CI_Handler::on_protocol_test>;
+		parsers[M::PROT_TEST_R2I]        = &Parse<M::ProtocolTest,        &CI_Handler::on_protocol_test>;
+		parsers[M::PROT_CONFIRM]         = &Parse<M::ProtocolNegotiation, &CI_Handler::on_protocol_confirm>;
+
+		parsers[M::PROF_INQUIRY]         = &Parse<M::Base,                &CI_Handler::on_profile_inquiry>;
+		parsers[M::PROF_INQUIRY_REPLY]   = &Parse<M::ProfileInquiryReply, &CI_Handler::on_profile_reply>;
+		parsers[M::PROF_SET_ON]          = &Parse<M::Profile,             &CI_Handler::on_profile>;
+		parsers[M::PROF_SET_OFF]         = &Parse<M::Profile,             &CI_Handler::on_profile>;
+		parsers[M::PROF_ENABLED]         = &Parse<M::Profile,             &CI_Handler::on_profile>;
+		parsers[M::PROF_DISABLED]        = &Parse<M::Profile,             &CI_Handler::on_profile>;
+		parsers[M::PROF_SPECIFIC]        = &Parse<M::ProfileSpecific,     &CI_Handler::on_profile_data>;
+
+		parsers[M::PROP_CAPS_INQUIRY]    = &Parse<M::PropertyCaps,        &CI_Handler::on_property_caps>;
+		parsers[M::PROP_CAPS_REPLY]      = &Parse<M::PropertyCaps,        &CI_Handler::on_property_caps>;
+		for (uint8_t t = M::PROP_HAS_INQUIRY; t <= M::PROP_SUBSCRIPTION_REPLY; ++t)
+			parsers[t]                   = &Parse<M::PropertyChunk,       &CI_Handler::on_property>;
+		parsers[M::PROP_NOTIFY]          = &Parse<M::PropertyChunk,       &CI_Handler::on_property>;
+	}
+
+	inline bool CI_Handler::receive(const SysEx_Message &message)
+	{
+		static const Table table;
+
+		SysEx_Reader reader(message);
+		reader.validate7();
+
+		M::Base base;
+		if (!base.read(reader)) return false;
+
+		if (Parser parse = table.parsers[base.ci_type()]) return parse(*this, base, reader);
+
+		on_other(base, reader);
+		return true;
+	}
 }
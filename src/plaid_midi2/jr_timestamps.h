@@ -0,0 +1,178 @@
+#pragma once
+
+
+#include <cstdint>
+
+#include "midi2.h"
+
+
+namespace midi2
+{
+	/*
+		Places timestamped UMP in local time, using JR (jitter reduction) messages.
+
+			A sender's JR Clock messages say what time it is on the sender's clock;  a JR Timestamp
+			says when the next message on the group was sent.  Both count 1/31250 s ticks and
+			wrap every ~2.1 seconds;  they are unwrapped here into a running count per group.
+
+			Each JR Clock is compared with the local time it arrived (in samples), to track the
+			sender's clock:  its offset from ours, and its rate (drift) relative to the sample rate.
+			Arrival times only ever run late, so earlier-than-expected arrivals are trusted more.
+
+			A timestamped message is placed at the sender's time, mapped to local time, plus a
+			fixed latency that absorbs transport jitter.  Messages without a timestamp, or from
+			a group whose clock isn't known yet, are placed when they arrive.
+	*/
+	class JR_Timing
+	{
+	public:
+		using local_time_t = int64_t;  // Local time, in samples
+
+		enum
+		{
+			TICKS_PER_SECOND = 31250,
+		};
+
+	public:
+		JR_Timing(double sampleRate = 48000.0, double latencySeconds = 0.001)    {configure(sampleRate, latencySeconds);}
+
+		/*
+			Set the local sample rate and the latency added to timestamps.  Forgets all clocks.
+		*/
+		void configure(double sampleRate, double latencySeconds);
+
+		/*
+			Forget the senders' clocks and any pending timestamps.
+		*/
+		void reset()    {for (Sync &s : groups) s = Sync();}
+
+		/*
+			Consume a JR Clock or JR Timestamp message that arrived at local time now.
+				Returns false for any other message, which should then be placed.
+		*/
+		bool receive(const UMP &message, local_time_t now);
+
+		/*
+			The local time at which a message on a group, arriving at now, should take effect.
+				Uses up the group's pending timestamp.  Never earlier than now.
+		*/
+		local_time_t place(uint8_t group, local_time_t now);
+
+		/*
+			The state of a sender's clock.
+				drift is the sender's rate relative to ours, minus 1 (so 1e-6 is one ppm fast).
+		*/
+		bool   synced(uint8_t group) const    {return groups[group & 0xF].synced;}
+		double drift (uint8_t group) const    {return groups[group & 0xF].rate - 1.0;}
+
+	private:
+		struct Sync
+		{
+			bool     synced     = false;
+			bool     stamped    = false;
+			uint16_t raw        = 0;   // Last clock reading, as sent
+			int64_t  tick       = 0;   // Unwrapped
+			int64_t  stamp      = 0;   // Pending timestamp, unwrapped
+			double   offset     = 0;   // Local time of tick 0, in samples
+			double   rate       = 1;   // Sender ticks per our ticks
+			int64_t  anchorTick = 0;   // Start of the current rate measurement
+			double   anchorTime = 0;
+
+			double local(int64_t t, double samplesPerTick) const    {return offset + double(t) * samplesPerTick / rate;}
+		};
+
+		void clock(Sync &s, uint16_t raw, local_time_t now);
+
+	private:
+		double samplesPerTick;
+		double latency;          // In samples
+		Sync   groups[16];
+	};
+}
+
+/*
+	********************************************************************
+	***********        IMPLEMENTATION      *****************************
+	********************************************************************
+*/
+
+namespace midi2
+{
+	inline void JR_Timing::configure(double sampleRate, double latencySeconds)
+	{
+		samplesPerTick = sampleRate / TICKS_PER_SECOND;
+		latency        = latencySeconds * sampleRate;
+		reset();
+	}
+
+	inline bool JR_Timing::receive(const UMP &message, local_time_t now)
+	{
+		uint32_t w0 = message.words[0];
+		if ((w0 >> 28) != UMP::UTILITY) return false;
+
+		Sync    &s   = groups[(w0 >> 24) & 0xF];
+		uint16_t raw = uint16_t(w0);
+
+		switch ((w0 >> 20) & 0xF)
+		{
+		case UMP::Utility::JR_CLOCK:
+			clock(s, raw, now);
+			return true;
+
+		case UMP::Utility::JR_TIMESTAMP:
+			// Timestamps are close to the sender's clock, so unwrap them around it.
+			s.stamp   = s.tick + int16_t(uint16_t(raw - s.raw));
+			s.stamped = true;
+			return true;
+		}
+		return false;
+	}
+
+	inline void JR_Timing::clock(Sync &s, uint16_t raw, local_time_t now)
+	{
+		if (!s.synced)
+		{
+			s.synced     = true;
+			s.raw        = raw;
+			s.tick       = raw;
+			s.rate       = 1;
+			s.offset     = double(now) - double(s.tick) * samplesPerTick;
+			s.anchorTick = s.tick;
+			s.anchorTime = double(now);
+			return;
+		}
+
+		s.tick += int16_t(uint16_t(raw - s.raw));
+		s.raw   = raw;
+
+		// Pull the estimate toward the arrival time:  quickly if it came early (less delay than
+		//   we thought), slowly if late (probably jitter).
+		double error = double(now) - s.local(s.tick, samplesPerTick);
+		s.offset += error * ((error < 0) ? 0.5 : 1.0 / 64);
+
+		// About once a second, measure the rate from the smoothed mapping and keep it continuous.
+		int64_t elapsed = s.tick - s.anchorTick;
+		if (elapsed >= TICKS_PER_SECOND)
+		{
+			double here     = s.local(s.tick, samplesPerTick);
+			double measured = double(elapsed) * samplesPerTick / (here - s.anchorTime);
+			if (measured > 0.99 && measured < 1.01) s.rate += (measured - s.rate) * 0.25;
+			s.offset     = here - double(s.tick) * samplesPerTick / s.rate;
+			s.anchorTick = s.tick;
+			s.anchorTime = here;
+		}
+	}
+
+	inline JR_Timing::local_time_t JR_Timing::place(uint8_t group, local_time_t now)
+	{
+		Sync &s = groups[group & 0xF];
+		if (!s.stamped) return now;
+		s.stamped = false;
+		if (!s.synced) return now;
+
+		// Late, or implausibly far ahead (a sender restart):  play now.
+		double when = s.local(s.stamp, samplesPerTick) + latency;
+		if (when <= double(now) || when > double(now) + TICKS_PER_SECOND * samplesPerTick) return now;
+		return local_time_t(when);
+	}
+}
@@ -0,0 +1,430 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include "midi2.h"
+#include "ump_stream.h"
+
+
+namespace midi2
+{
+	/*
+		Translates a MIDI 1.0 byte stream into Universal MIDI Packets.
+
+			Parsing is table-driven and keeps state per group:  running status, partial
+			messages, and SysEx in progress.  System real-time bytes may appear anywhere,
+			even inside other messages.  SysEx becomes Data_8_Byte packets as it arrives;
+			a status byte other than real-time ends it.
+
+			Channel voice messages become MIDI 1.0 voice packets, or with upscale set,
+			MIDI 2.0 voice packets at full resolution (per the UMP default translation):
+				- values are scaled up with min-center-max scaling
+				- note on with velocity 0 becomes note off
+				- bank select is held for program change;  RPN/NRPN and data entry become
+				  registered/assignable controllers
+	*/
+	class Midi1_To_UMP
+	{
+	public:
+		bool upscale = false;
+
+	public:
+		Midi1_To_UMP()    {reset();}
+
+		/*
+			Forget all partial messages, running status and controller state.
+		*/
+		void reset();
+
+		/*
+			Translate bytes received on a group, passing each UMP to output(const UMP&).
+		*/
+		template<typename Output>
+		void feed(const uint8_t *bytes, size_t count, uint8_t group, Output &&output);
+
+		/*
+			Translate bytes into a word buffer.  Stops early if the buffer is nearly full.
+				Returns the number of bytes consumed.
+		*/
+		size_t feed(const uint8_t *bytes, size_t count, uint8_t group, UMP_StreamWriter &out);
+
+		/*
+			Length of a MIDI 1.0 message, including the status byte;  0 for undefined statuses.
+				SysEx (F0) counts as 1.
+		*/
+		static uint8_t Message_Length(uint8_t status);
+
+		/*
+			Scale a value from one bit depth to a larger one, mapping minimum, center and maximum exactly.
+		*/
+		static uint32_t Scale_Up(uint32_t value, uint8_t sourceBits, uint8_t destBits);
+
+	private:
+		struct Channel
+		{
+			uint8_t bankMsb, bankLsb;
+			bool    bankValid;
+			uint8_t paramMsb, paramLsb;   // 7F 7F:  none selected
+			bool    paramNrpn;
+			uint8_t dataMsb;
+		};
+
+		struct Group
+		{
+			uint8_t status, running;      // Message in progress;  running status
+			uint8_t data[2], count, expected;
+			bool    sysex, started;
+			uint8_t sysexBytes[6], sysexCount;
+			Channel channels[16];
+		};
+
+		template<typename Output>
+		void voice(Group &g, uint8_t group, Output &&output);
+
+		template<typename Output>
+		void sysex_packet(Group &g, uint8_t group, bool last, Output &&output);
+
+	private:
+		Group groups[16];
+	};
+
+
+	/*
+		Translates Universal MIDI Packets into MIDI 1.0 bytes.
+
+			MIDI 1.0 voice, system and SysEx7 packets translate directly.  MIDI 2.0 voice
+			messages are scaled down;  registered/assignable controllers become RPN/NRPN
+			sequences and program changes carry their bank select.  Other messages are dropped.
+	*/
+	class UMP_To_Midi1
+	{
+	public:
+		enum
+		{
+			MAX_BYTES = 12,  // Largest translation of one packet (an RPN sequence)
+		};
+
+		/*
+			Translate one packet into out, which needs room for MAX_BYTES.
+				Returns the number of bytes written.
+		*/
+		static size_t Translate(const UMP &packet, uint8_t *out);
+
+		/*
+			Translate a stream, stopping before a packet that doesn't fit.
+				Returns the number of bytes written;  consumed is set to the number of words read.
+		*/
+		static size_t Translate(const UMP_Stream &stream, uint8_t *out, size_t capacity, size_t *consumed = nullptr);
+	};
+}
+
+/*
+	********************************************************************
+	***********        IMPLEMENTATION      *****************************
+	********************************************************************
+*/
+
+namespace midi2
+{
+	inline uint8_t Midi1_To_UMP::Message_Length(uint8_t status)
+	{
+		static const uint8_t VOICE_LENGTH[8] = {3, 3, 3, 3, 2, 2, 3, 0};
+		static const uint8_t SYSTEM_LENGTH[16] =
+		{
+			1, 2, 3, 2, 0, 0, 1, 0,   // F0 ... F7:  SysEx, MTC, song position, song select, -, -, tune request, end of SysEx
+			1, 0, 1, 1, 1, 0, 1, 1,   // F8 ... FF:  real-time
+		};
+		if (status < 0x80) return 0;
+		return (status < 0xF0) ? VOICE_LENGTH[(status>>4) & 7] : SYSTEM_LENGTH[status & 0xF];
+	}
+
+	inline uint32_t Midi1_To_UMP::Scale_Up(uint32_t value, uint8_t sourceBits, uint8_t destBits)
+	{
+		uint8_t  scaleBits = uint8_t(destBits - sourceBits);
+		uint32_t shifted   = value << scaleBits;
+		if (value <= (1u << (sourceBits - 1))) return shifted;
+
+		// Above center, repeat the lower bits to fill the range.
+		uint8_t  repeatBits = uint8_t(sourceBits - 1);
+		uint32_t repeat     = value & ((1u << repeatBits) - 1);
+		repeat = (scaleBits > repeatBits) ? (repeat << (scaleBits - repeatBits)) : (repeat >> (repeatBits - scaleBits));
+		while (repeat) {shifted |= repeat; repeat >>= repeatBits;}
+		return shifted;
+	}
+
+	inline void Midi1_To_UMP::reset()
+	{
+		for (Group &g : groups)
+		{
+			g = Group();
+			for (Channel &c : g.channels) {c = Channel(); c.paramMsb = c.paramLsb = 0x7F;}
+		}
+	}
+
+	template<typename Output>
+	void Midi1_To_UMP::feed(const uint8_t *bytes, size_t count, uint8_t group, Output &&output)
+	{
+		group &= 0xF;
+		Group &g = groups[group];
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			uint8_t b = bytes[i];
+
+			if (b >= 0xF8)
+			{
+				// Real-time:  doesn't disturb anything in progress.
+				if (Message_Length(b)) output(UMP((uint32_t(UMP::SYSTEM) << 28) | (uint32_t(group) << 24) | (uint32_t(b) << 16)));
+				continue;
+			}
+
+			if (b & 0x80)
+			{
+				if (g.sysex) {sysex_packet(g, group, true, output); g.sysex = false;}
+				if (b == 0xF7) continue;
+
+				g.status   = b;
+				g.running  = (b < 0xF0) ? b : 0;
+				g.count    = 0;
+				g.expected = uint8_t(Message_Length(b) - (Message_Length(b) ? 1 : 0));
+
+				if (b == 0xF0) {g.sysex = true; g.started = false; g.sysexCount = 0; g.status = 0;}
+				else if (g.expected == 0)
+				{
+					if (b == UMP::System::TUNE_REQUEST) output(UMP((uint32_t(UMP::SYSTEM) << 28) | (uint32_t(group) << 24) | (uint32_t(b) << 16)));
+					g.status = 0;
+				}
+				continue;
+			}
+
+			if (g.sysex)
+			{
+				if (g.sysexCount == 6) sysex_packet(g, group, false, output);
+				g.sysexBytes[g.sysexCount++] = b;
+				continue;
+			}
+
+			if (!g.status)
+			{
+				// Running status, or a stray data byte.
+				if (!g.running) continue;
+				g.status   = g.running;
+				g.count    = 0;
+				g.expected = uint8_t(Message_Length(g.running) - 1);
+			}
+
+			g.data[g.count++] = b;
+			if (g.count < g.expected) continue;
+
+			if (g.status < 0xF0) voice(g, group, output);
+			else output(UMP((uint32_t(UMP::SYSTEM) << 28) | (uint32_t(group) << 24) | (uint32_t(g.status) << 16)
+				| (uint32_t(g.data[0]) << 8) | (g.expected > 1 ? uint32_t(g.data[1]) : 0)));
+			g.status = 0;
+		}
+	}
+
+	inline size_t Midi1_To_UMP::feed(const uint8_t *bytes, size_t count, uint8_t group, UMP_StreamWriter &out)
+	{
+		// One byte yields at most two packets of up to two words each.
+		size_t i = 0;
+		for (; i < count && out.capacity - out.length >= 4; ++i)
+			feed(bytes + i, 1, group, [&](const UMP &packet) {out.write(packet);});
+		return i;
+	}
+
+	template<typename Output>
+	void Midi1_To_UMP::sysex_packet(Group &g, uint8_t group, bool last, Output &&output)
+	{
+		uint8_t status = g.started ?
+			(last ? UMP::Data8::SYSEX7_END      : UMP::Data8::SYSEX7_CONTINUE) :
+			(last ? UMP::Data8::SYSEX7_COMPLETE : UMP::Data8::SYSEX7_BEGIN);
+
+		UMP packet((uint32_t(UMP::DATA_8_BYTE) << 28) | (uint32_t(group) << 24) | (uint32_t(status) << 20) | (uint32_t(g.sysexCount) << 16));
+		for (uint8_t i = 0, k = 2; i < g.sysexCount; ++i, ++k)
+			packet.words[k>>2] |= uint32_t(g.sysexBytes[i]) << (24 - 8*(k&3));
+
+		output(static_cast<const UMP&>(packet));
+		g.started    = true;
+		g.sysexCount = 0;
+	}
+
+	template<typename Output>
+	void Midi1_To_UMP::voice(Group &g, uint8_t group, Output &&output)
+	{
+		using CV2 = UMP::CV2;
+
+		uint8_t status = g.status, d1 = g.data[0], d2 = (g.expected > 1) ? g.data[1] : 0;
+		uint8_t grpChan = uint8_t((group << 4) | (status & 0xF));
+
+		if (!upscale)
+		{
+			output(UMP((uint32_t(UMP::MIDI1_VOICE) << 28) | (uint32_t(group) << 24) | (uint32_t(status) << 16) | (uint32_t(d1) << 8) | d2));
+			return;
+		}
+
+		Channel &c = g.channels[status & 0xF];
+		switch (status >> 4)
+		{
+		case CV2::NOTE_OFF:
+			output(CV2::Note_Off(grpChan, d1, uint16_t(Scale_Up(d2, 7, 16))));
+			break;
+
+		case CV2::NOTE_ON:
+			// Velocity 0 means note off, at the default velocity.
+			if (d2) output(CV2::Note_On (grpChan, d1, uint16_t(Scale_Up(d2, 7, 16))));
+			else    output(CV2::Note_Off(grpChan, d1, uint16_t(Scale_Up(0x40, 7, 16))));
+			break;
+
+		case CV2::NOTE_PRESSURE:
+			output(CV2::Note_Pressure(grpChan, d1, Scale_Up(d2, 7, 32)));
+			break;
+
+		case CV2::CHAN_PRESSURE:
+			output(CV2::Chan_Pressure(grpChan, Scale_Up(d1, 7, 32)));
+			break;
+
+		case CV2::PITCH_BEND:
+			output(UMP(CV2::_word0(grpChan, CV2::PITCH_BEND, 0, 0), Scale_Up(uint32_t(d1) | (uint32_t(d2) << 7), 14, 32)));
+			break;
+
+		case CV2::PROGRAM:
+			output(UMP(CV2::_word0(grpChan, CV2::PROGRAM, 0, c.bankValid ? 1 : 0),
+				(uint32_t(d1) << 24) | (uint32_t(c.bankMsb) << 8) | c.bankLsb));
+			break;
+
+		case CV2::CC:
+			switch (d1)
+			{
+			case 0:   c.bankMsb  = d2; c.bankValid = true;  break;
+			case 32:  c.bankLsb  = d2;                      break;
+			case 99:  c.paramMsb = d2; c.paramNrpn = true;  break;
+			case 98:  c.paramLsb = d2; c.paramNrpn = true;  break;
+			case 101: c.paramMsb = d2; c.paramNrpn = false; break;
+			case 100: c.paramLsb = d2; c.paramNrpn = false; break;
+			case 6:
+			case 38:
+				{
+					// Data entry:  sent on the MSB, then again with the LSB.
+					if (c.paramMsb == 0x7F && c.paramLsb == 0x7F) break;
+					uint32_t value = (d1 == 6) ? (uint32_t(d2) << 7) : ((uint32_t(c.dataMsb) << 7) | d2);
+					if (d1 == 6) c.dataMsb = d2;
+					value = Scale_Up(value, 14, 32);
+					output(c.paramNrpn ? CV2::Chan_AC(grpChan, c.paramMsb, c.paramLsb, value) : CV2::Chan_RC(grpChan, c.paramMsb, c.paramLsb, value));
+				}
+				break;
+			default:
+				output(CV2::Chan_CC(grpChan, d1, Scale_Up(d2, 7, 32)));
+				break;
+			}
+			break;
+		}
+	}
+
+
+	inline size_t UMP_To_Midi1::Translate(const UMP &packet, uint8_t *out)
+	{
+		using CV2 = UMP::CV2;
+
+		uint32_t w0 = packet.words[0], w1 = packet.words[1];
+		uint8_t *o  = out;
+
+		switch (packet.messageType())
+		{
+		case UMP::SYSTEM:
+			{
+				uint8_t status = uint8_t(w0 >> 16), length = Midi1_To_UMP::Message_Length(status);
+				if (status < 0xF1 || !length) break;
+				*o++ = status;
+				if (length > 1) *o++ = uint8_t(w0 >> 8) & 0x7F;
+				if (length > 2) *o++ = uint8_t(w0) & 0x7F;
+			}
+			break;
+
+		case UMP::MIDI1_VOICE:
+			{
+				uint8_t status = uint8_t(w0 >> 16), length = Midi1_To_UMP::Message_Length(status);
+				if (status < 0x80 || status >= 0xF0) break;
+				*o++ = status;
+				*o++ = uint8_t(w0 >> 8) & 0x7F;
+				if (length > 2) *o++ = uint8_t(w0) & 0x7F;
+			}
+			break;
+
+		case UMP::DATA_8_BYTE:
+			{
+				auto   &data   = static_cast<const UMP::Data8&>(packet);
+				uint8_t status = data.status(), count = data.byteCount();
+				if (count > 6 || status > UMP::Data8::SYSEX7_END) break;
+				if (status == UMP::Data8::SYSEX7_COMPLETE || status == UMP::Data8::SYSEX7_BEGIN) *o++ = 0xF0;
+				for (uint8_t i = 0; i < count; ++i) *o++ = data.data(i) & 0x7F;
+				if (status == UMP::Data8::SYSEX7_COMPLETE || status == UMP::Data8::SYSEX7_END) *o++ = 0xF7;
+			}
+			break;
+
+		case UMP::MIDI2_VOICE:
+			{
+				uint8_t opcode = (w0 >> 20) & 0xF, chan = (w0 >> 16) & 0xF, i1 = (w0 >> 8) & 0x7F, i2 = w0 & 0x7F;
+				uint8_t cc = uint8_t(0xB0 | chan);
+				auto control = [&](uint8_t index, uint8_t value) {*o++ = cc; *o++ = index; *o++ = value;};
+
+				switch (opcode)
+				{
+				case CV2::NOTE_OFF:
+					*o++ = uint8_t(0x80 | chan); *o++ = i1; *o++ = uint8_t(w1 >> 25);
+					break;
+				case CV2::NOTE_ON:
+					// Velocity 0 would mean note off.
+					*o++ = uint8_t(0x90 | chan); *o++ = i1; *o++ = (w1 >> 25) ? uint8_t(w1 >> 25) : 1;
+					break;
+				case CV2::NOTE_PRESSURE:
+					*o++ = uint8_t(0xA0 | chan); *o++ = i1; *o++ = uint8_t(w1 >> 25);
+					break;
+				case CV2::CC:
+					control(i1, uint8_t(w1 >> 25));
+					break;
+				case CV2::PROGRAM:
+					if (w0 & 1) {control(0, (w1 >> 8) & 0x7F); control(32, w1 & 0x7F);}
+					*o++ = uint8_t(0xC0 | chan); *o++ = (w1 >> 24) & 0x7F;
+					break;
+				case CV2::CHAN_PRESSURE:
+					*o++ = uint8_t(0xD0 | chan); *o++ = uint8_t(w1 >> 25);
+					break;
+				case CV2::PITCH_BEND:
+					*o++ = uint8_t(0xE0 | chan); *o++ = (w1 >> 18) & 0x7F; *o++ = uint8_t(w1 >> 25);
+					break;
+				case CV2::RC:
+				case CV2::AC:
+					{
+						bool nrpn = (opcode == CV2::AC);
+						control(nrpn ? 99 : 101, i1);
+						control(nrpn ? 98 : 100, i2);
+						control(6,  uint8_t(w1 >> 25));
+						control(38, (w1 >> 18) & 0x7F);
+					}
+					break;
+				}
+			}
+			break;
+		}
+		return size_t(o - out);
+	}
+
+	inline size_t UMP_To_Midi1::Translate(const UMP_Stream &stream, uint8_t *out, size_t capacity, size_t *consumed)
+	{
+		size_t length = 0;
+		size_t words  = 0;
+		uint8_t scratch[MAX_BYTES];
+
+		for (UMP_Stream::Message message : stream)
+		{
+			size_t n = Translate(message.copy(), scratch);
+			if (n > capacity - length) break;
+			for (size_t i = 0; i < n; ++i) out[length++] = scratch[i];
+			words += message.size;
+		}
+		if (consumed) *consumed = words;
+		return length;
+	}
+}
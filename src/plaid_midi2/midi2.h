@@ -202,6 +202,7 @@ namespace midi2
 
 	class UMP::Data_8_Byte : public UMP
 	{
+	public:
 		// Data opcodes, used with MT_DATA and MT_DATA_EXT
 		enum STATUS
 		{
@@ -220,6 +221,46 @@ namespace midi2
 			MIXED_DATA_HEADER  = 0x8,
 			MIXED_DATA_PAYLOAD = 0x9,
 		};
+
+	public:
+		/*
+			SysEx7 packets:
+				status    -- SYSEX7_COMPLETE, SYSEX7_BEGIN, SYSEX7_CONTINUE or SYSEX7_END
+				byteCount -- number of data bytes (0-6)
+				data(i)   -- data byte i
+		*/
+		uint8_t status   () const           {return (words[0]>>20) & 0xF;}
+		uint8_t byteCount() const           {return (words[0]>>16) & 0xF;}
+		uint8_t data     (uint8_t i) const  {return uint8_t(words[(i+2)>>2] >> (24 - 8*((i+2)&3)));}
+	};
+
+	class UMP::Data_16_Byte : public UMP
+	{
+	public:
+		// Data opcodes, used with MT_DATA_16_BYTE
+		enum STATUS
+		{
+			SYSEX8_COMPLETE = 0x0,
+			SYSEX8_BEGIN    = 0x1,
+			SYSEX8_CONTINUE = 0x2,
+			SYSEX8_END      = 0x3,
+
+			MIXED_DATA_HEADER  = 0x8,
+			MIXED_DATA_PAYLOAD = 0x9,
+		};
+
+	public:
+		/*
+			SysEx8 packets:
+				status    -- SYSEX8_COMPLETE, SYSEX8_BEGIN, SYSEX8_CONTINUE or SYSEX8_END
+				byteCount -- number of bytes including the stream ID (1-14)
+				streamId  -- identifies concurrent SysEx8 messages
+				data(i)   -- data byte i, following the stream ID (up to 13)
+		*/
+		uint8_t status   () const           {return (words[0]>>20) & 0xF;}
+		uint8_t byteCount() const           {return (words[0]>>16) & 0xF;}
+		uint8_t streamId () const           {return (words[0]>>8) & 0xFF;}
+		uint8_t data     (uint8_t i) const  {return uint8_t(words[(i+3)>>2] >> (24 - 8*((i+3)&3)));}
 	};
 
 
@@ -285,7 +326,7 @@ namespace midi2
 		*/
 		uint8_t opcode()          const    {return (words[0]>>20) & 0xF;}
 		uint8_t channel()         const    {return (words[0]>>16) & 0xF;}
-		uint8_t groupAndChannel() const    {return (group()<<4u) & channel();}
+		uint8_t groupAndChannel() const    {return (group()<<4u) | channel();}
 
 		/*
 			Classify opcode.
@@ -345,8 +386,8 @@ namespace midi2
 		/*
 			Get common fields.
 		*/
-		uint8_t data_1() const    {return (words[0]>>20) & 0xF;}
-		uint8_t data_2() const    {return (words[0]>>16) & 0xF;}
+		uint8_t data_1() const    {return (words[0]>>8) & 0x7F;}
+		uint8_t data_2() const    {return (words[0]   ) & 0x7F;}
 
 
 		/*
@@ -506,7 +547,7 @@ namespace midi2
 	}
 	inline UMP UMP::CV1::Chan_PitchBend(grpchan_t grpChan, pitchBend14_t bend)
 	{
-		return UMP(_word(grpChan, CHAN_CONTROL, bend&0x7F, ((bend^0x2000)>>7)&0x7F));
+		return UMP(_word(grpChan, CHAN_PITCH_BEND, (bend^0x2000)&0x7F, ((bend^0x2000)>>7)&0x7F));
 	}
 
 
@@ -572,7 +613,7 @@ namespace midi2
 	inline UMP UMP::CV2::Note_PitchBend(uint8_t grpChan, uint8_t note, int32_t value)
 	{
 		return UMP(
-			_word0(grpChan, NOTE_PITCH_BEND, 0, 0),
+			_word0(grpChan, NOTE_PITCH_BEND, note, 0),
 			uint32_t(value) ^ 0x80000000
 		);
 	}
@@ -0,0 +1,228 @@
+#pragma once
+
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "midi2.h"
+#include "ump_stream.h"
+
+
+namespace midi2
+{
+	/*
+		The current state of every note, kept from incoming MIDI 2.0 channel voice messages.
+
+			State is stored as parallel arrays (one per field), indexed by group, channel and note
+			(see Index), so a voice reads its values directly and each message costs O(1).
+			Channel-wide state -- pitch bend, pressure and control changes -- is kept alongside.
+
+			Per-note controllers are kept for a fixed number of registered and assignable indices,
+			chosen with track_registered / track_assignable;  a lookup table maps each index to
+			its column, so others are skipped without searching.
+
+			Note management:  Reset restores a note's controllers to their defaults.  Detach
+			advances the note's generation, so a voice can tell that later controllers belong
+			to a newer note (compare generation() with its value at note on).
+
+			MIDI 1.0 voice messages are ignored;  translate them with Midi1_To_UMP::upscale.
+	*/
+	class Note_State
+	{
+	public:
+		enum
+		{
+			NOTES     = 128,
+			CHANNELS  = 16,
+			UNTRACKED = 0xFF,
+		};
+
+		static const uint32_t BEND_CENTER = 0x80000000u;
+
+	public:
+		/*
+			groupCount        -- groups to track, from group 0;  messages for others are ignored
+			controllerSlots   -- per-note controllers that can be tracked (registered and assignable)
+		*/
+		Note_State(uint8_t groupCount = 1, uint8_t controllerSlots = 8);
+
+		/*
+			Track a per-note registered or assignable controller.
+				Returns its column, or UNTRACKED if all slots are taken.
+		*/
+		uint8_t track_registered(uint8_t index)    {return track(registeredColumn, index);}
+		uint8_t track_assignable(uint8_t index)    {return track(assignableColumn, index);}
+
+		/*
+			Apply incoming messages.
+		*/
+		void apply(const UMP &message)    {apply(message.words);}
+		void apply(const UMP_Stream &stream);
+
+		/*
+			Forget all notes and restore defaults.  Tracked controllers stay tracked.
+		*/
+		void reset();
+
+		/*
+			Index a note, for the accessors below.
+		*/
+		static size_t Index(uint8_t group, uint8_t channel, uint8_t note)    {return (size_t((group & 0xF) * CHANNELS + (channel & 0xF)) << 7) | (note & 0x7F);}
+
+		/*
+			Per-note state.
+				velocity and attribute are from the last note on;  pitchBend is centered on BEND_CENTER.
+		*/
+		bool     active       (size_t note) const    {return activeNotes[note] != 0;}
+		uint8_t  generation   (size_t note) const    {return generations[note];}
+		uint16_t velocity     (size_t note) const    {return velocities[note];}
+		uint8_t  attributeType(size_t note) const    {return attributeTypes[note];}
+		uint16_t attribute    (size_t note) const    {return attributes[note];}
+		uint32_t pressure     (size_t note) const    {return pressures[note];}
+		uint32_t pitchBend    (size_t note) const    {return pitchBends[note];}
+		uint32_t controller   (uint8_t column, size_t note) const    {return controllers[column * noteCount + note];}
+
+		/*
+			Channel state, indexed by group and channel.
+		*/
+		uint32_t channelPitchBend(uint8_t group, uint8_t channel) const             {return channelBends    [(group & 0xF) * CHANNELS + (channel & 0xF)];}
+		uint32_t channelPressure (uint8_t group, uint8_t channel) const             {return channelPressures[(group & 0xF) * CHANNELS + (channel & 0xF)];}
+		uint32_t channelCC       (uint8_t group, uint8_t channel, uint8_t cc) const {return channelCCs[(((group & 0xF) * CHANNELS + (channel & 0xF)) << 7) | (cc & 0x7F)];}
+
+	private:
+		void    apply(const UMP::word_t *words);
+		uint8_t track(uint8_t *columns, uint8_t index);
+
+	private:
+		uint8_t groupCount, slots, slotsUsed;
+		size_t  noteCount;
+
+		// Per note
+		std::vector<uint8_t>  activeNotes, generations, attributeTypes;
+		std::vector<uint16_t> velocities, attributes;
+		std::vector<uint32_t> pressures, pitchBends;
+		std::vector<uint32_t> controllers;   // slots columns of noteCount
+
+		// Per channel
+		std::vector<uint32_t> channelBends, channelPressures, channelCCs;
+
+		uint8_t registeredColumn[256], assignableColumn[256];
+	};
+}
+
+/*
+	********************************************************************
+	***********        IMPLEMENTATION      *****************************
+	********************************************************************
+*/
+
+namespace midi2
+{
+	inline Note_State::Note_State(uint8_t _groupCount, uint8_t controllerSlots) :
+		groupCount(_groupCount > 16 ? 16 : _groupCount), slots(controllerSlots), slotsUsed(0),
+		noteCount(size_t(groupCount) * CHANNELS * NOTES),
+		activeNotes(noteCount), generations(noteCount), attributeTypes(noteCount),
+		velocities(noteCount), attributes(noteCount),
+		pressures(noteCount), pitchBends(noteCount), controllers(noteCount * slots),
+		channelBends(size_t(groupCount) * CHANNELS), channelPressures(size_t(groupCount) * CHANNELS),
+		channelCCs(size_t(groupCount) * CHANNELS * 128)
+	{
+		for (uint8_t &c : registeredColumn) c = UNTRACKED;
+		for (uint8_t &c : assignableColumn) c = UNTRACKED;
+		reset();
+	}
+
+	inline uint8_t Note_State::track(uint8_t *columns, uint8_t index)
+	{
+		if (columns[index] == UNTRACKED && slotsUsed < slots) columns[index] = slotsUsed++;
+		return columns[index];
+	}
+
+	inline void Note_State::reset()
+	{
+		std::fill(activeNotes.begin(), activeNotes.end(), 0);
+		std::fill(velocities .begin(), velocities .end(), 0);
+		std::fill(attributeTypes.begin(), attributeTypes.end(), 0);
+		std::fill(attributes .begin(), attributes .end(), 0);
+		std::fill(pressures  .begin(), pressures  .end(), 0);
+		std::fill(pitchBends .begin(), pitchBends .end(), uint32_t(BEND_CENTER));
+		std::fill(controllers.begin(), controllers.end(), 0);
+		std::fill(channelBends    .begin(), channelBends    .end(), uint32_t(BEND_CENTER));
+		std::fill(channelPressures.begin(), channelPressures.end(), 0);
+		std::fill(channelCCs      .begin(), channelCCs      .end(), 0);
+	}
+
+	inline void Note_State::apply(const UMP_Stream &stream)
+	{
+		for (UMP_Stream::Message message : stream.filter(UMP_Stream::Filter::Type(UMP::MIDI2_VOICE)))
+			apply(message.words);
+	}
+
+	inline void Note_State::apply(const UMP::word_t *words)
+	{
+		using CV2 = UMP::CV2;
+
+		uint32_t w0 = words[0], w1 = words[1];
+		uint8_t  group = (w0 >> 24) & 0xF;
+		if ((w0 >> 28) != UMP::MIDI2_VOICE || group >= groupCount) return;
+
+		size_t  channel = size_t(group) * CHANNELS + ((w0 >> 16) & 0xF);
+		size_t  note    = (channel << 7) | ((w0 >> 8) & 0x7F);
+		uint8_t index   = uint8_t(w0);
+		uint8_t column;
+
+		switch ((w0 >> 20) & 0xF)
+		{
+		case CV2::NOTE_ON:
+			activeNotes   [note] = 1;
+			velocities    [note] = uint16_t(w1 >> 16);
+			attributeTypes[note] = index;
+			attributes    [note] = uint16_t(w1);
+			break;
+
+		case CV2::NOTE_OFF:
+			activeNotes[note] = 0;
+			break;
+
+		case CV2::NOTE_PRESSURE:
+			pressures[note] = w1;
+			break;
+
+		case CV2::NOTE_PITCH_BEND:
+			pitchBends[note] = w1;
+			break;
+
+		case CV2::NOTE_RC:
+			if ((column = registeredColumn[index]) != UNTRACKED) controllers[column * noteCount + note] = w1;
+			break;
+
+		case CV2::NOTE_AC:
+			if ((column = assignableColumn[index]) != UNTRACKED) controllers[column * noteCount + note] = w1;
+			break;
+
+		case CV2::NOTE_MANAGEMENT:
+			if (index & 0x2) ++generations[note];   // Detach
+			if (index & 0x1)                        // Reset
+			{
+				pressures [note] = 0;
+				pitchBends[note] = BEND_CENTER;
+				for (uint8_t c = 0; c < slotsUsed; ++c) controllers[c * noteCount + note] = 0;
+			}
+			break;
+
+		case CV2::CHAN_PITCH_BEND:
+			channelBends[channel] = w1;
+			break;
+
+		case CV2::CHAN_PRESSURE:
+			channelPressures[channel] = w1;
+			break;
+
+		case CV2::CHAN_CC:
+			channelCCs[note] = w1;  // Same layout as notes, with the CC index in place of the note
+			break;
+		}
+	}
+}
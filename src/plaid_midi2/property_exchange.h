@@ -0,0 +1,490 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "ci.h"
+
+
+namespace midi2
+{
+	/*
+		A streaming JSON tokenizer that never allocates.
+
+			Text may be fed in pieces of any size, split anywhere.  Each token goes to a handler,
+			called as handler(const JSON_Scanner::Token&).  Strings, numbers and literals are
+			collected into a fixed buffer;  longer ones are truncated (see Token::truncated).
+			Escapes are decoded;  \u escapes outside ASCII become '?'.
+	*/
+	class JSON_Scanner
+	{
+	public:
+		enum TOKEN
+		{
+			OBJECT_BEGIN, OBJECT_END,
+			ARRAY_BEGIN,  ARRAY_END,
+			KEY,     // An object key
+			STRING,
+			NUMBER,
+			LITERAL, // true, false or null
+		};
+
+		enum
+		{
+			MAX_TEXT  = 128,
+			MAX_DEPTH = 32,
+		};
+
+		struct Token
+		{
+			TOKEN       type;
+			const char *text;       // KEY, STRING, NUMBER and LITERAL;  null-terminated
+			size_t      length;
+			bool        truncated;
+			int         depth;      // 1 for members of the outermost object or array
+
+			bool is(const char *s) const    {return std::strcmp(text, s) == 0;}
+			long number() const;
+		};
+
+	public:
+		JSON_Scanner()    {reset();}
+
+		void reset()    {state = VALUE; depth = 0; arrays = 0; length = 0; truncated = false; fail = false; finished = false;}
+
+		/*
+			Feed more text.  Returns false once the text is found to be malformed.
+		*/
+		template<typename Handler>
+		bool feed(const uint8_t *text, size_t count, Handler &&handler);
+
+		bool failed() const    {return fail;}
+		bool done  () const    {return finished;}  // The outermost value has ended
+
+	private:
+		enum STATE
+		{
+			VALUE,          // Expecting a value
+			KEY_OR_END,     // After '{':  a key or '}'
+			NEXT_KEY,       // After ',' in an object
+			COLON,
+			AFTER,          // After a value:  ',' or the end of the container
+			IN_STRING, IN_ESCAPE, IN_UNICODE,
+			IN_ATOM,        // A number or literal
+		};
+
+		bool in_array() const    {return depth && ((arrays >> (depth-1)) & 1);}
+
+		void append(char c)    {if (length < MAX_TEXT) text[length++] = c; else truncated = true;}
+
+		template<typename Handler>
+		void emit(TOKEN type, Handler &&handler)
+		{
+			text[length] = 0;
+			Token token = {type, text, length, truncated, depth};
+			handler(static_cast<const Token&>(token));
+			length = 0; truncated = false;
+		}
+
+		void value_done()    {state = AFTER; if (!depth) finished = true;}
+
+	private:
+		STATE    state;
+		int      depth;
+		uint32_t arrays;           // Bit N:  container N is an array
+		bool     string_is_key;
+		uint8_t  unicode_digits;
+		uint32_t unicode;
+		char     text[MAX_TEXT + 1];
+		size_t   length;
+		bool     truncated, fail, finished;
+	};
+
+
+	/*
+		The fields of a Property Exchange header that affect how a message is handled.
+			Strings are truncated to fit.
+	*/
+	struct PE_Header
+	{
+	public:
+		enum ENCODING
+		{
+			ENCODING_ASCII         = 0,
+			ENCODING_MCODED7       = 1,
+			ENCODING_ZLIB_MCODED7  = 2,  // Decoded from Mcoded7 only;  decompression is up to the receiver
+		};
+
+		char     resource[64]    = {};
+		char     resId[64]       = {};
+		char     command[16]     = {};
+		char     subscribeId[32] = {};
+		char     mediaType[64]   = {};
+		ENCODING encoding        = ENCODING_ASCII;
+		int      status          = 0;   // Replies
+		long     offset          = -1;  // Paginated lists;  -1 if absent
+		long     limit           = -1;
+		long     totalCount      = -1;
+		bool     setPartial      = false;
+
+	public:
+		/*
+			Parse a header.  Unknown fields are skipped.  Returns false if the JSON is malformed.
+		*/
+		bool parse(const uint8_t *json, size_t length);
+	};
+
+
+	/*
+		Mcoded7:  8-bit data sent as 7-bit bytes.  Each group of up to 7 bytes is preceded by
+			a byte holding their high bits (the first byte's in bit 6).
+			The decoder is streaming;  groups may be split across chunks.
+	*/
+	class Mcoded7_Decoder
+	{
+	public:
+		void reset()    {index = 0; high = 0;}
+
+		/*
+			Decode count bytes into out, which needs room for count bytes.
+				Returns the number of bytes decoded.
+		*/
+		size_t decode(const uint8_t *in, size_t count, uint8_t *out)
+		{
+			uint8_t *o = out;
+			for (size_t i = 0; i < count; ++i)
+			{
+				if (index == 0) high = in[i];
+				else            *o++ = uint8_t(in[i] | (((high >> (7 - index)) & 1) << 7));
+				index = (index == 7) ? 0 : index + 1;
+			}
+			return size_t(o - out);
+		}
+
+	private:
+		uint8_t index = 0, high = 0;
+	};
+
+	// Encode count bytes into out, which needs room for Mcoded7_Size(count) bytes.  Returns the encoded size.
+	size_t Mcoded7_Encode(const uint8_t *in, size_t count, uint8_t *out);
+
+	inline size_t Mcoded7_Size(size_t count)    {return count + (count + 6) / 7;}
+
+
+	/*
+		Receives Property Exchange messages:  inquiries or replies, split into chunks.
+
+			The header is parsed from the first chunk.  Data is decoded (from Mcoded7 if the
+			header says so) and passed on chunk by chunk as it arrives, so a large property
+			never needs to be held whole.  Optionally it is also collected into a buffer,
+			allocated up front and shared between concurrent requests, for delivery whole.
+
+			Override the PE_Receiver::on_ methods to handle messages.
+	*/
+	class PE_Receiver
+	{
+	public:
+		using Chunk = CI_Message::PropertyChunk;
+
+		/*
+			bufferBytes   -- total space for collecting data;  0 to only stream it
+			maxRequests   -- requests (per source MUID and request ID) in progress at once
+		*/
+		PE_Receiver(size_t bufferBytes = 65536, size_t maxRequests = 4);
+		virtual ~PE_Receiver() {}
+
+		/*
+			Process a chunk.  Returns false if it was ignored:  no room for another request,
+				or a chunk of a request that wasn't started.
+		*/
+		bool receive(const Chunk &chunk);
+
+		/*
+			Abandon all requests in progress, or one (such as one that timed out).
+		*/
+		void reset()    {for (Request &r : requests) r.active = false;}
+		void abandon(MUID source, uint8_t requestId)
+		{
+			for (Request &r : requests) if (r.active && r.source == source && r.requestId == requestId) r.active = false;
+		}
+
+	public:
+		// The first chunk of a message has arrived.
+		virtual void on_header  (const Chunk &chunk, const PE_Header &header) {}
+
+		// Decoded data from one chunk, starting at offset within the property.
+		virtual void on_data    (const Chunk &chunk, const uint8_t *data, size_t length, size_t offset) {}
+
+		// The last chunk has arrived.  data holds the whole property if it fit in the buffer, or is null.
+		virtual void on_complete(const Chunk &chunk, const PE_Header &header, const uint8_t *data, size_t length) {}
+
+	private:
+		struct Request
+		{
+			bool            active = false;
+			MUID            source;
+			uint8_t         requestId = 0;
+			PE_Header       header;
+			Mcoded7_Decoder decoder;
+			uint8_t        *buffer = nullptr;
+			size_t          length = 0;       // Decoded so far
+			bool            overflow = false;
+		};
+
+		Request *find(const Chunk &chunk, bool start);
+
+	private:
+		size_t               share;     // Buffer bytes per request
+		std::vector<uint8_t> buffer;
+		std::vector<uint8_t> scratch;   // For decoding when not collecting
+		std::vector<Request> requests;
+	};
+}
+
+/*
+	********************************************************************
+	***********        IMPLEMENTATION      *****************************
+	********************************************************************
+*/
+
+namespace midi2
+{
+	inline long JSON_Scanner::Token::number() const
+	{
+		long v = 0;
+		bool negative = (length && text[0] == '-');
+		for (size_t i = negative; i < length && text[i] >= '0' && text[i] <= '9'; ++i) v = v * 10 + (text[i] - '0');
+		return negative ? -v : v;
+	}
+
+	template<typename Handler>
+	bool JSON_Scanner::feed(const uint8_t *bytes, size_t count, Handler &&handler)
+	{
+		for (size_t i = 0; i < count && !fail; ++i)
+		{
+			char c = char(bytes[i]);
+
+			switch (state)
+			{
+			case IN_STRING:
+				if (c == '"')
+				{
+					if (string_is_key) {emit(KEY,    handler); state = COLON;}
+					else               {emit(STRING, handler); value_done();}
+				}
+				else if (c == '\\') state = IN_ESCAPE;
+				else append(c);
+				continue;
+
+			case IN_ESCAPE:
+				switch (c)
+				{
+				case 'b': append('\b'); break;
+				case 'f': append('\f'); break;
+				case 'n': append('\n'); break;
+				case 'r': append('\r'); break;
+				case 't': append('\t'); break;
+				case 'u': unicode = 0; unicode_digits = 0; state = IN_UNICODE; continue;
+				default:  append(c);    break;
+				}
+				state = IN_STRING;
+				continue;
+
+			case IN_UNICODE:
+				{
+					int digit = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+					if (digit < 0) {fail = true; continue;}
+					unicode = (unicode << 4) | uint32_t(digit);
+					if (++unicode_digits == 4) {append(unicode < 0x80 ? char(unicode) : '?'); state = IN_STRING;}
+				}
+				continue;
+
+			case IN_ATOM:
+				if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '.' || c == '-' || c == '+' || c == 'E')
+				{
+					append(c);
+					continue;
+				}
+				emit((text[0] == '-' || (text[0] >= '0' && text[0] <= '9')) ? NUMBER : LITERAL, handler);
+				value_done();
+				break;  // c is handled below, after the value
+
+			default:
+				break;
+			}
+
+			if (c == ' ' || c == '\t' || c == '\n' || c == '\r') continue;
+
+			switch (state)
+			{
+			case VALUE:
+				if (finished) {fail = true; break;}
+				if (c == '{' || c == '[')
+				{
+					if (depth == MAX_DEPTH) {fail = true; break;}
+					arrays = (c == '[') ? (arrays | (1u << depth)) : (arrays & ~(1u << depth));
+					++depth;
+					emit((c == '[') ? ARRAY_BEGIN : OBJECT_BEGIN, handler);
+					state = (c == '[') ? VALUE : KEY_OR_END;
+				}
+				else if (c == '"')                   {string_is_key = false; state = IN_STRING;}
+				else if (c == ']' && in_array())     {--depth; emit(ARRAY_END, handler); value_done();}  // Empty array
+				else                                 {append(c); state = IN_ATOM;}
+				break;
+
+			case KEY_OR_END:
+				if (c == '}') {--depth; emit(OBJECT_END, handler); value_done(); break;}
+				// fall through
+			case NEXT_KEY:
+				if (c == '"') {string_is_key = true; state = IN_STRING;}
+				else fail = true;
+				break;
+
+			case COLON:
+				if (c == ':') state = VALUE;
+				else fail = true;
+				break;
+
+			case AFTER:
+				if (!depth)                          fail = true;
+				else if (c == ',')                   state = in_array() ? VALUE : NEXT_KEY;
+				else if (c == ']' &&  in_array())    {--depth; emit(ARRAY_END,  handler); value_done();}
+				else if (c == '}' && !in_array())    {--depth; emit(OBJECT_END, handler); value_done();}
+				else                                 fail = true;
+				break;
+
+			default:
+				break;
+			}
+		}
+		return !fail;
+	}
+
+
+	inline bool PE_Header::parse(const uint8_t *json, size_t length)
+	{
+		*this = PE_Header();
+
+		JSON_Scanner scanner;
+		char key[16] = {};
+		auto copy = [](char *to, size_t size, const JSON_Scanner::Token &t) {std::strncpy(to, t.text, size - 1); to[size-1] = 0;};
+
+		scanner.feed(json, length, [&](const JSON_Scanner::Token &t)
+		{
+			// Only the outermost object's members matter.
+			if (t.depth != 1) return;
+			if (t.type == JSON_Scanner::KEY) {copy(key, sizeof(key), t); return;}
+
+			if (t.type == JSON_Scanner::STRING)
+			{
+				if      (!std::strcmp(key, "resource"))       copy(resource,    sizeof(resource),    t);
+				else if (!std::strcmp(key, "resId"))          copy(resId,       sizeof(resId),       t);
+				else if (!std::strcmp(key, "command"))        copy(command,     sizeof(command),     t);
+				else if (!std::strcmp(key, "subscribeId"))    copy(subscribeId, sizeof(subscribeId), t);
+				else if (!std::strcmp(key, "mediaType"))      copy(mediaType,   sizeof(mediaType),   t);
+				else if (!std::strcmp(key, "mutualEncoding"))
+				{
+					encoding = t.is("Mcoded7") ? ENCODING_MCODED7 : t.is("zlib+Mcoded7") ? ENCODING_ZLIB_MCODED7 : ENCODING_ASCII;
+				}
+			}
+			else if (t.type == JSON_Scanner::NUMBER)
+			{
+				if      (!std::strcmp(key, "status"))     status     = int(t.number());
+				else if (!std::strcmp(key, "offset"))     offset     = t.number();
+				else if (!std::strcmp(key, "limit"))      limit      = t.number();
+				else if (!std::strcmp(key, "totalCount")) totalCount = t.number();
+			}
+			else if (t.type == JSON_Scanner::LITERAL)
+			{
+				if (!std::strcmp(key, "setPartial")) setPartial = t.is("true");
+			}
+		});
+		return !scanner.failed() && (scanner.done() || length == 0);
+	}
+
+
+	inline size_t Mcoded7_Encode(const uint8_t *in, size_t count, uint8_t *out)
+	{
+		uint8_t *o = out;
+		for (size_t group = 0; group < count; group += 7)
+		{
+			size_t   n    = (count - group < 7) ? (count - group) : 7;
+			uint8_t *high = o++;
+			*high = 0;
+			for (size_t i = 0; i < n; ++i)
+			{
+				*high |= uint8_t((in[group+i] >> 7) << (6 - i));
+				*o++   = in[group+i] & 0x7F;
+			}
+		}
+		return size_t(o - out);
+	}
+
+
+	inline PE_Receiver::PE_Receiver(size_t bufferBytes, size_t maxRequests) :
+		share(maxRequests ? bufferBytes / maxRequests : 0), buffer(share * maxRequests),
+		scratch(0x3FFF), requests(maxRequests ? maxRequests : 1)
+	{
+		for (size_t i = 0; i < maxRequests; ++i) requests[i].buffer = buffer.data() + i * share;
+	}
+
+	inline PE_Receiver::Request *PE_Receiver::find(const Chunk &chunk, bool start)
+	{
+		Request *free = nullptr;
+		for (Request &r : requests)
+		{
+			if (r.active && r.source == chunk.source() && r.requestId == chunk.request_id) return &r;
+			if (!r.active && !free) free = &r;
+		}
+		return start ? free : nullptr;
+	}
+
+	inline bool PE_Receiver::receive(const Chunk &chunk)
+	{
+		bool first = (chunk.chunk_index <= 1);
+		Request *r = find(chunk, first);
+		if (!r) return false;
+
+		if (first)
+		{
+			r->active    = true;
+			r->source    = chunk.source();
+			r->requestId = chunk.request_id;
+			r->length    = 0;
+			r->overflow  = false;
+			r->decoder.reset();
+			r->header.parse(chunk.header.bytes, chunk.header.length);
+			on_header(chunk, r->header);
+		}
+
+		// Decode straight into the collection buffer when there's room, or into scratch space.
+		const uint8_t *data   = chunk.data.bytes;
+		size_t         length = chunk.data.length;
+		bool           collect = !r->overflow && r->length + length <= share;
+		r->overflow = !collect;
+
+		if (r->header.encoding != PE_Header::ENCODING_ASCII)
+		{
+			uint8_t *out = collect ? r->buffer + r->length : scratch.data();
+			length = r->decoder.decode(data, length, out);
+			data   = out;
+		}
+		else if (collect && length)
+		{
+			std::memcpy(r->buffer + r->length, data, length);
+		}
+
+		if (length) on_data(chunk, data, length, r->length);
+		r->length += length;
+
+		if (chunk.chunk_count != 0 && chunk.last_chunk())
+		{
+			r->active = false;
+			on_complete(chunk, r->header, r->overflow ? nullptr : r->buffer, r->length);
+		}
+		return true;
+	}
+}
@@ -2,7 +2,17 @@
 
 
 
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__) || defined(__x86_64__)
+	#include <emmintrin.h>
+	#define PLAID_MIDI2_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+	#include <arm_neon.h>
+	#define PLAID_MIDI2_NEON 1
+#endif
 
 #include "sysex_fields.h"
 
@@ -18,6 +28,12 @@ namespace midi2
 
 			SYSEX_SUBID1_MIDI_CI = 0x0D,
 		};
+
+		/*
+			Find the first byte with its high bit set, or end if there is none.
+				Checks 16 bytes at a time with SSE2 or NEON, 8 at a time otherwise.
+		*/
+		const byte_t *Find_High_Bit(const byte_t *begin, const byte_t *end);
 	}
 
 	/*
@@ -51,7 +67,7 @@ namespace midi2
 		{
 			DEFAULT       = 0x00,
 			SYSEX7        = 0x80,            // High bit produces an error.
-			SYSEX8        = 0x80,            // (no effect)
+			SYSEX8        = 0x00,            // (no effect)
 			//LITTLE_ENDIAN = 0x00, LE = 0x00, // (no effect)
 			//BIG_ENDIAN    = 0x01, BE = 0x01, // Currently unsupported
 		};
@@ -111,17 +127,28 @@ namespace midi2
 	{
 	public:
 		const uint8_t *pos, *end;
+		const uint8_t *clean7; // Bytes before this are known to have no high bits set.
 
 	public:
-		SysEx_Reader(const SysEx_Message &message)    : pos(message.bytes), end(message.bytes + message.length) {}
+		SysEx_Reader(const SysEx_Message &message)    : pos(message.bytes), end(message.bytes + message.length), clean7(message.bytes) {}
 
 		/*
 			Check for stop conditions
-				eof  -- we have reached
-				
+				eof  -- we have reached the end of the message.
 		*/
 		bool eof () const    {return pos >= end;}
 
+		/*
+			Check the rest of the message for high bits in one pass.
+				SysEx7 reads within the checked bytes then skip their own per-byte checks.
+				Returns false if a high bit was found;  reads reaching that byte will fail.
+		*/
+		bool validate7()
+		{
+			clean7 = sysex::Find_High_Bit(pos, end);
+			return clean7 == end;
+		}
+
 		/*
 			Read bytes.
 				read<N> or read(n) returns a pointer to the next N bytes (if available).
@@ -135,8 +162,8 @@ namespace midi2
 		template<          int FLAGS=0> const uint8_t* read7(            size_t n)    {return read<  FLAGS|SYSEX7>(n);}
 		template<size_t N, int FLAGS=0> bool           read (uint8_t *v);
 		template<          int FLAGS=0> bool           read (uint8_t *v, size_t n);
-		template<size_t N, int FLAGS=0> bool           read7(uint8_t *v)              {return pull<N,FLAGS|SYSEX7>(v);}
-		template<          int FLAGS=0> bool           read7(uint8_t *v, size_t n)    {return pull<  FLAGS|SYSEX7>(v,n);}
+		template<size_t N, int FLAGS=0> bool           read7(uint8_t *v)              {return read<N,FLAGS|SYSEX7>(v);}
+		template<          int FLAGS=0> bool           read7(uint8_t *v, size_t n)    {return read<  FLAGS|SYSEX7>(v,n);}
 
 		/*
 			Read common number formats:
@@ -177,9 +204,9 @@ namespace midi2
 			// Conversion to bool indicates whether successful.
 			operator bool() const    {return !fail;}
 
-			// iostream-style writing.
+			// iostream-style reading.  Stops at the first failure.
 			template<typename SysExField>
-			Operation &operator>>(const SysExField &field)    {fail &= !reader.read(field); return *this;}
+			Operation &operator>>(SysExField &field)    {if (!fail) fail = !reader.read(field); return *this;}
 		};
 	};
 
@@ -189,10 +216,15 @@ namespace midi2
 	class SysEx_Writer : public SysEx_IO
 	{
 	public:
-		uint8_t *pos, *limit;
+		uint8_t *start, *pos, *limit;
 
 	public:
-		SysEx_Writer(const Byte_Buffer &buffer)    : pos(buffer.bytes), limit(buffer.bytes + buffer.capacity) {}
+		SysEx_Writer(const Byte_Buffer &buffer)    : start(buffer.bytes), pos(buffer.bytes), limit(buffer.bytes + buffer.capacity) {}
+
+		/*
+			The message written so far (for sending, as with SysEx_Fragmenter).
+		*/
+		SysEx_Message written() const    {return SysEx_Message{start, size_t(((pos < limit) ? pos : limit) - start)};}
 
 		/*
 			Check for stop conditions.
@@ -212,8 +244,8 @@ namespace midi2
 		/* ... */                       uint8_t* writebuf(                size_t n);
 		template<size_t N, int FLAGS=0> bool     write (const uint8_t *v);
 		template<          int FLAGS=0> bool     write (const uint8_t *v, size_t n);
-		template<size_t N, int FLAGS=0> bool     write7(const uint8_t *v)              {write<N,FLAGS|>(data,n);}
-		template<          int FLAGS=0> bool     write7(const uint8_t *v, size_t n)    {write<  FLAGS|>(data,n);}
+		template<size_t N, int FLAGS=0> bool     write7(const uint8_t *v)              {return write<N,FLAGS|SYSEX7>(v);}
+		template<          int FLAGS=0> bool     write7(const uint8_t *v, size_t n)    {return write<  FLAGS|SYSEX7>(v,n);}
 
 		/*
 			Write common number formats:
@@ -255,9 +287,9 @@ namespace midi2
 			// Conversion to bool indicates whether successful.
 			operator bool() const    {return !fail;}
 
-			// iostream-style writing.
+			// iostream-style writing.  Stops at the first failure.
 			template<typename SysExField>
-			Operation &operator<<(const SysExField &field)    {fail &= !writer.write(field); return *this;}
+			Operation &operator<<(const SysExField &field)    {if (!fail) fail = !writer.write(field); return *this;}
 		};
 	};
 }
@@ -365,6 +397,32 @@ namespace midi2
 	}*/
 
 
+	inline const sysex::byte_t *sysex::Find_High_Bit(const byte_t *p, const byte_t *end)
+	{
+#if PLAID_MIDI2_SSE2
+		for (; end - p >= 16; p += 16)
+		{
+			int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+			if (mask) {while (!(mask & 1)) {mask >>= 1; ++p;} return p;}
+		}
+#elif PLAID_MIDI2_NEON
+		for (; end - p >= 16; p += 16)
+		{
+			if (vmaxvq_u8(vld1q_u8(p)) & 0x80) break;
+		}
+#else
+		for (; end - p >= 8; p += 8)
+		{
+			uint64_t word;
+			std::memcpy(&word, p, 8);
+			if (word & 0x8080808080808080ull) break;
+		}
+#endif
+		for (; p < end; ++p) if (*p & 0x80) break;
+		return p;
+	}
+
+
 	template<size_t N, int FLAGS>
 	inline const uint8_t* SysEx_Reader::read()
 	{
@@ -375,7 +433,8 @@ namespace midi2
 			return nullptr;
 		}
 
-		if (FLAGS & SYSEX7) for (size_t i=0; i<N; ++i)
+		// Bytes covered by validate7() are skipped.
+		if ((FLAGS & SYSEX7) && pos > clean7) for (size_t i=0; i<N; ++i)
 		{
 			if (p[i] & 0x80)
 			{
@@ -395,11 +454,12 @@ namespace midi2
 			return nullptr;
 		}
 
-		if (FLAGS & SYSEX7) for (size_t i=0; i<n; ++i)
+		if ((FLAGS & SYSEX7) && pos > clean7)
 		{
-			if (p[i] & 0x80)
+			const uint8_t *bad = sysex::Find_High_Bit((p > clean7) ? p : clean7, pos);
+			if (bad != pos)
 			{
-				fail_at(p+i, FAIL_7BIT, "illegal high bit during SysEx7 read");
+				fail_at(bad, FAIL_7BIT, "illegal high bit during SysEx7 read");
 				return nullptr;
 			}
 		}
@@ -421,7 +481,7 @@ namespace midi2
 	{
 		if (const uint8_t *p = read<FLAGS>(n))
 		{
-			for (size_t i=0; i<n; ++i) v[i] = p[i];
+			if (n) std::memcpy(v, p, n);
 			return true;
 		}
 		else return false;
@@ -430,7 +490,7 @@ namespace midi2
 	template<typename SysExField>
 	bool SysEx_Reader::read(SysExField &field)
 	{
-		if (auto w = read<SysExField::IS_7_BIT ? SYSEX7 : SYSEX8>())
+		if (auto w = read<SysExField::BYTE_SIZE, SysExField::IS_7_BIT ? SYSEX7 : SYSEX8>())
 		{
 			if (field.read_noByteCheck(w)) return 1;
 			else fail_at(w, FAIL_INVALID, "illegal value for field");
@@ -442,7 +502,7 @@ namespace midi2
 	template<size_t N>
 	inline uint8_t* SysEx_Writer::writebuf()
 	{
-		const uint8_t *p = pos; pos += N;
+		uint8_t *p = pos; pos += N;
 		if (pos > limit)
 		{
 			fail_at(p, FAIL_OVERRUN, "insufficient capacity for writing");
@@ -0,0 +1,262 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "midi2.h"
+#include "sysex.h"
+#include "ump_stream.h"
+
+
+namespace midi2
+{
+	/*
+		A System Exclusive message (or part of one) produced by SysEx_Assembler.
+	*/
+	struct SysEx_Event
+	{
+	public:
+		SysEx_Message message;   // Valid until the assembler is next used
+		uint8_t       group;
+		uint8_t       streamId;  // SysEx8 only
+		bool          sysex8;
+		bool          first;     // Begins a message
+		bool          last;      // Ends a message
+
+	public:
+		// Whole messages are both first and last;  oversized messages may arrive in parts.
+		bool complete() const    {return first && last;}
+
+		SysEx_Reader reader() const    {return SysEx_Reader(message);}
+	};
+
+	/*
+		Reassembles System Exclusive messages from UMP data packets or MIDI 1.0 SysEx dumps.
+
+			Each group has a fixed-size buffer for SysEx7 and another for SysEx8, all allocated
+			up front, so nothing is allocated while assembling.  A MIDI 1.0 dump that holds a
+			whole message (F0 ... F7) is passed on in place, without copying.
+
+			Messages that outgrow their buffer are handled by the overflow policy:
+				OVERFLOW_SPLIT -- pass the message on in buffer-sized parts (see SysEx_Event::first/last)
+				OVERFLOW_DROP  -- discard the message
+
+			Completed messages go to a handler, called as handler(const SysEx_Event&).
+	*/
+	class SysEx_Assembler
+	{
+	public:
+		enum OVERFLOW_POLICY
+		{
+			OVERFLOW_SPLIT = 0,
+			OVERFLOW_DROP  = 1,
+		};
+
+	public:
+		const size_t          capacity;  // Per group, for each of SysEx7 and SysEx8
+		const OVERFLOW_POLICY policy;
+
+		uint32_t dropped = 0; // Messages discarded:  interrupted, unterminated or overflowing.
+
+	public:
+		SysEx_Assembler(size_t capacity = 2048, OVERFLOW_POLICY policy = OVERFLOW_SPLIT) :
+			capacity(capacity), policy(policy), arena(capacity * 2 * 16)
+		{
+			for (size_t i = 0; i < 32; ++i) slots[i].bytes = arena.data() + i * capacity;
+		}
+
+		SysEx_Assembler(const SysEx_Assembler&) = delete;
+		SysEx_Assembler &operator=(const SysEx_Assembler&) = delete;
+
+		/*
+			Feed a UMP.  Returns false if it isn't a SysEx7 or SysEx8 packet.
+		*/
+		template<typename Handler>
+		bool push(const UMP &packet, Handler &&handler);
+
+		/*
+			Feed every packet in a buffer.
+		*/
+		template<typename Handler>
+		void push(const UMP_Stream &stream, Handler &&handler)    {for (auto message : stream) push(message.as<UMP>(), handler);}
+
+		/*
+			Feed a MIDI 1.0 SysEx dump, as from a VST or MIDI 1.0 driver, on the given group.
+				A dump may hold a whole message (F0 ... F7) or continue one begun by an earlier dump.
+				Real-time bytes (F8-FF) are skipped;  other status bytes cancel the message.
+		*/
+		template<typename Handler>
+		void push_midi1(const uint8_t *bytes, size_t length, uint8_t group, Handler &&handler);
+
+		/*
+			Discard all incomplete messages.
+		*/
+		void reset()    {for (Slot &slot : slots) slot.active = false;}
+
+	private:
+		struct Slot
+		{
+			uint8_t *bytes;
+			size_t   length   = 0;
+			bool     active   = false;
+			bool     split    = false; // Part of this message was already passed on
+			uint8_t  streamId = 0;
+		};
+
+		Slot &slot(uint8_t group, bool sysex8)    {return slots[(group & 0xF) * 2 + sysex8];}
+
+		void begin(Slot &slot, uint8_t streamId)
+		{
+			if (slot.active) ++dropped;
+			slot.active   = true;
+			slot.split    = false;
+			slot.length   = 0;
+			slot.streamId = streamId;
+		}
+
+		template<typename Handler>
+		void append(Slot &slot, const uint8_t *data, size_t count, uint8_t group, bool sysex8, Handler &&handler)
+		{
+			while (slot.active && count)
+			{
+				if (slot.length == capacity)
+				{
+					if (policy == OVERFLOW_DROP) {slot.active = false; ++dropped; return;}
+
+					emit(slot, group, sysex8, false, handler);
+					slot.split  = true;
+					slot.length = 0;
+				}
+				size_t n = (capacity - slot.length < count) ? (capacity - slot.length) : count;
+				std::memcpy(slot.bytes + slot.length, data, n);
+				slot.length += n;
+				data  += n;
+				count -= n;
+			}
+		}
+
+		template<typename Handler>
+		void emit(Slot &slot, uint8_t group, bool sysex8, bool last, Handler &&handler)
+		{
+			SysEx_Event event = {{slot.bytes, slot.length}, group, slot.streamId, sysex8, !slot.split, last};
+			handler(static_cast<const SysEx_Event&>(event));
+		}
+
+		template<typename Handler>
+		void finish(Slot &slot, uint8_t group, bool sysex8, Handler &&handler)
+		{
+			if (!slot.active) return;
+			slot.active = false;
+			emit(slot, group, sysex8, true, handler);
+		}
+
+	private:
+		std::vector<uint8_t> arena;
+		Slot                 slots[32];
+	};
+}
+
+/*
+	********************************************************************
+	***********        IMPLEMENTATION      *****************************
+	********************************************************************
+*/
+
+namespace midi2
+{
+	template<typename Handler>
+	bool SysEx_Assembler::push(const UMP &packet, Handler &&handler)
+	{
+		uint8_t data[13], count, status, streamId = 0, group = packet.group();
+		bool    sysex8;
+
+		switch (packet.messageType())
+		{
+		case UMP::DATA_8_BYTE:
+			{
+				auto &p = static_cast<const UMP::Data8&>(packet);
+				status = p.status();
+				count  = (p.byteCount() < 6) ? p.byteCount() : 6;
+				for (uint8_t i = 0; i < count; ++i) data[i] = p.data(i);
+				sysex8 = false;
+				if (status > UMP::Data8::SYSEX7_END) return false;
+			}
+			break;
+		case UMP::DATA_16_BYTE:
+			{
+				auto &p = static_cast<const UMP::Data16&>(packet);
+				status   = p.status();
+				count    = (p.byteCount() > 14) ? 13 : (p.byteCount() ? p.byteCount() - 1 : 0);
+				streamId = p.streamId();
+				for (uint8_t i = 0; i < count; ++i) data[i] = p.data(i);
+				sysex8 = true;
+				if (status > UMP::Data16::SYSEX8_END) return false;
+			}
+			break;
+		default:
+			return false;
+		}
+
+		// SysEx7 and SysEx8 use the same status numbers.
+		Slot &s = slot(group, sysex8);
+		switch (status)
+		{
+		case UMP::Data16::SYSEX8_COMPLETE:
+			{
+				if (s.active) {s.active = false; ++dropped;}
+				SysEx_Event event = {{data, count}, group, streamId, sysex8, true, true};
+				handler(static_cast<const SysEx_Event&>(event));
+			}
+			break;
+		case UMP::Data16::SYSEX8_BEGIN:
+			begin(s, streamId);
+			append(s, data, count, group, sysex8, handler);
+			break;
+		case UMP::Data16::SYSEX8_CONTINUE:
+		case UMP::Data16::SYSEX8_END:
+			// Packets from another SysEx8 stream, or with no message begun, are ignored.
+			if (!s.active || s.streamId != streamId) break;
+			append(s, data, count, group, sysex8, handler);
+			if (status == UMP::Data16::SYSEX8_END) finish(s, group, sysex8, handler);
+			break;
+		}
+		return true;
+	}
+
+	template<typename Handler>
+	void SysEx_Assembler::push_midi1(const uint8_t *bytes, size_t length, uint8_t group, Handler &&handler)
+	{
+		Slot &s = slot(group, false);
+
+		// A whole message in one dump is passed on where it is.
+		if (!s.active && length >= 2 && bytes[0] == 0xF0 && bytes[length-1] == 0xF7 &&
+			sysex::Find_High_Bit(bytes + 1, bytes + length - 1) == bytes + length - 1)
+		{
+			SysEx_Event event = {{bytes + 1, length - 2}, group, 0, false, true, true};
+			handler(static_cast<const SysEx_Event&>(event));
+			return;
+		}
+
+		const uint8_t *end = bytes + length;
+		while (bytes < end)
+		{
+			// Copy a run of data bytes, then handle the status byte that ends it.
+			const uint8_t *status = sysex::Find_High_Bit(bytes, end);
+			if (s.active) append(s, bytes, status - bytes, group, false, handler);
+			if (status == end) break;
+
+			switch (*status)
+			{
+			case 0xF0: begin(s, 0);                       break;
+			case 0xF7: finish(s, group, false, handler);  break;
+			default:
+				if (*status < 0xF8 && s.active) {s.active = false; ++dropped;}
+				break;
+			}
+			bytes = status + 1;
+		}
+	}
+}
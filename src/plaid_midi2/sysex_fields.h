@@ -1,7 +1,10 @@
 #pragma once
 
 
+#include <cstddef>
 #include <cstdint>
+#include <initializer_list>
+#include <utility>
 
 
 namespace midi2
@@ -45,35 +48,52 @@ namespace midi2
 
 			/*
 				Read and write operations.
+					These are unrolled at compile time, one statement per byte.
 			*/
-			bool write(byte_t *data) const
-			{
-				static const T sh[] = {Shifts...};
-				T safe = value & FIELD_MASK;
-				for (size_t i = 0; i < BYTE_SIZE; ++i) data[i] = (safe >> sh[i]);
-				return value == safe;
+			bool write(byte_t *data) const
+			{
+				T safe = value & FIELD_MASK;
+				Encode(data, safe, Bytes());
+				return value == safe;
 			}
-			bool read(const byte_t *data)
-			{
-				static const T sh[] = {Shifts...};
-				value = 0;
-				byte_t verify = 0;
-				for (size_t i = 0; i < BYTE_SIZE; ++i)
-				{
-					verify |= data[i];
-					value |= T(data[i]&BYTE_MASK) << sh[i];
-				}
-				return !(verify & ~BYTE_MASK) && (value & FIELD_MASK) == value;
+			bool read(const byte_t *data)
+			{
+				value = Decode(data, Bytes());
+				return !(Verify(data, Bytes()) & ~BYTE_MASK) && (value & FIELD_MASK) == value;
 			}
 
-			bool read_noByteCheck(const byte_t *data)
-			{
-				static const T sh[] = {Shifts...};
-				value = 0;
-				for (size_t i = 0; i < BYTE_SIZE; ++i) value |= T(data[i]&BYTE_MASK) << sh[i];
-				return (value & FIELD_MASK) == value;
+			bool read_noByteCheck(const byte_t *data)
+			{
+				value = Decode(data, Bytes());
+				return (value & FIELD_MASK) == value;
 			}
 
+		private:
+			using Bytes = std::make_index_sequence<BYTE_SIZE>;
+
+			// Byte I goes with shift number I.
+			template<size_t ... I>
+			static T Decode(const byte_t *data, std::index_sequence<I...>)
+			{
+				T v = 0;
+				(void) std::initializer_list<int>{(v |= T(T(data[I]&BYTE_MASK) << Shifts), 0)...};
+				return v;
+			}
+			template<size_t ... I>
+			static void Encode(byte_t *data, T v, std::index_sequence<I...>)
+			{
+				(void) std::initializer_list<int>{(data[I] = byte_t((v >> Shifts) & BYTE_MASK), 0)...};
+			}
+			template<size_t ... I>
+			static byte_t Verify(const byte_t *data, std::index_sequence<I...>)
+			{
+				byte_t verify = 0;
+				(void) std::initializer_list<int>{(verify |= data[I], 0)...};
+				return verify;
+			}
+
+		public:
+
 #if 0
 			/*
 				Various operators
@@ -107,12 +127,12 @@ namespace midi2
 #endif
 
 			// Fault-tolerant read
-			/*T read(const byte_t *data)
-			{
-				static const T sh[] = {Shifts...};
-				T val = 0;
-				for (size_t i = 0; i < BYTE_SIZE; ++i) val |= T(data[i]) << sh[i];
-				return val;
+			/*T read(const byte_t *data)
+			{
+				static const T sh[] = {Shifts...};
+				T val = 0;
+				for (size_t i = 0; i < BYTE_SIZE; ++i) val |= T(data[i]) << sh[i];
+				return val;
 			}*/
 		};
 
@@ -0,0 +1,159 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include "midi2.h"
+#include "sysex.h"
+#include "ump_stream.h"
+
+
+namespace midi2
+{
+	/*
+		Splits a System Exclusive message into UMP data packets:  SysEx7 (Data_8_Byte, 6 bytes each)
+			or SysEx8 (Data_16_Byte, 13 bytes each).
+
+			Packets are built from the message bytes straight into an output word buffer.
+			The message isn't copied, so its bytes must stay valid until done().
+
+			Pacing:  packetsPerCall limits how many packets each write() produces, so a large
+			transfer can be spread over many blocks instead of flooding the output.  0 means no limit.
+	*/
+	class SysEx_Fragmenter
+	{
+	public:
+		size_t packetsPerCall = 0;
+
+	public:
+		SysEx_Fragmenter() {}
+
+		/*
+			Start sending a message, abandoning any message in progress.
+				streamId is only used by SysEx8.
+		*/
+		void begin(const SysEx_Message &message, uint8_t _group, bool _sysex8 = false, uint8_t _streamId = 0)
+		{
+			pos      = message.bytes;
+			end      = message.bytes + message.length;
+			group    = _group & 0xF;
+			sysex8   = _sysex8;
+			streamId = _streamId;
+			started  = false;
+			pending  = true;
+		}
+
+		/*
+			Whether the whole message has been written.
+		*/
+		bool done() const    {return !pending;}
+
+		/*
+			Packets still to write.
+		*/
+		size_t packetsRemaining() const    {return pending ? Packet_Count(size_t(end - pos), sysex8) : 0;}
+
+		/*
+			Write packets into out, as many as fit (and pacing allows).
+				Returns the number of packets written.
+		*/
+		size_t write(UMP_StreamWriter &out);
+
+		/*
+			Write the next packet into a UMP.  Returns false if done.
+		*/
+		bool next(UMP &packet);
+
+		/*
+			Number of packets needed for a message of the given length.
+		*/
+		static size_t Packet_Count(size_t length, bool sysex8)
+		{
+			size_t payload = sysex8 ? SYSEX8_PAYLOAD : SYSEX7_PAYLOAD;
+			return length ? (length + payload - 1) / payload : 1;
+		}
+
+	private:
+		enum
+		{
+			SYSEX7_PAYLOAD = 6,
+			SYSEX8_PAYLOAD = 13,
+		};
+
+		// Build one packet into words[0 .. size).
+		void pack(UMP::word_t *words);
+
+	private:
+		const uint8_t *pos = nullptr, *end = nullptr;
+		uint8_t        group = 0, streamId = 0;
+		bool           sysex8 = false, started = false, pending = false;
+	};
+}
+
+/*
+	********************************************************************
+	***********        IMPLEMENTATION      *****************************
+	********************************************************************
+*/
+
+namespace midi2
+{
+	inline void SysEx_Fragmenter::pack(UMP::word_t *words)
+	{
+		size_t  payload = sysex8 ? SYSEX8_PAYLOAD : SYSEX7_PAYLOAD;
+		size_t  left    = size_t(end - pos);
+		uint8_t count   = uint8_t((left < payload) ? left : payload);
+		bool    last    = (left <= payload);
+
+		// SysEx7 and SysEx8 use the same status numbers.
+		uint8_t status = started ?
+			(last ? UMP::Data16::SYSEX8_END      : UMP::Data16::SYSEX8_CONTINUE) :
+			(last ? UMP::Data16::SYSEX8_COMPLETE : UMP::Data16::SYSEX8_BEGIN);
+
+		uint8_t first;  // Packet byte holding the first data byte
+		if (sysex8)
+		{
+			words[0] = (uint32_t(UMP::DATA_16_BYTE) << 28) | (uint32_t(status) << 20) | (uint32_t(count + 1) << 16) | (uint32_t(streamId) << 8);
+			words[1] = words[2] = words[3] = 0;
+			first = 3;
+		}
+		else
+		{
+			words[0] = (uint32_t(UMP::DATA_8_BYTE) << 28) | (uint32_t(status) << 20) | (uint32_t(count) << 16);
+			words[1] = 0;
+			first = 2;
+		}
+		words[0] |= uint32_t(group) << 24;
+
+		for (uint8_t i = 0, k = first; i < count; ++i, ++k)
+			words[k>>2] |= uint32_t(pos[i]) << (24 - 8*(k&3));
+
+		pos    += count;
+		started = true;
+		pending = !last;
+	}
+
+	inline size_t SysEx_Fragmenter::write(UMP_StreamWriter &out)
+	{
+		size_t size  = sysex8 ? 4 : 2;
+		size_t limit = packetsPerCall ? packetsPerCall : size_t(-1);
+		size_t count = 0;
+
+		while (pending && count < limit && out.capacity - out.length >= size)
+		{
+			pack(out.words + out.length);
+			out.length += size;
+			++count;
+		}
+		return count;
+	}
+
+	inline bool SysEx_Fragmenter::next(UMP &packet)
+	{
+		if (!pending) return false;
+		packet = UMP();
+		pack(packet.words);
+		return true;
+	}
+}
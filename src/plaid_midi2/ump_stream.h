@@ -0,0 +1,241 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include "midi2.h"
+
+
+namespace midi2
+{
+	/*
+		A read-only view of packed Universal MIDI Packets:  a buffer of 32-bit words
+			where each message takes only as many words as its type needs (1-4).
+
+			Messages are visited in place, without copying them into 128-bit UMP objects.
+			A message cut off by the end of the buffer is not visited;  see truncated().
+	*/
+	class UMP_Stream
+	{
+	public:
+		using word_t = UMP::word_t;
+
+		/*
+			A message within the stream.
+		*/
+		class Message
+		{
+		public:
+			const word_t *words;
+			uint8_t       size;  // In words (1-4)
+
+		public:
+			uint8_t group      () const    {return (words[0]>>24) & 0xF;}
+			uint8_t messageType() const    {return (words[0]>>28) & 0xF;}
+
+			/*
+				View the message as a UMP (or a UMP subclass, like UMP::CV2).
+					Only the message's own words may be read through this view.
+			*/
+			template<typename T = UMP>
+			const T &as() const    {return *reinterpret_cast<const T*>(words);}
+
+			// Copy into a full-size UMP, with unused words zeroed.
+			UMP copy() const
+			{
+				UMP packet;
+				for (uint8_t i = 0; i < size; ++i) packet.words[i] = words[i];
+				return packet;
+			}
+		};
+
+		/*
+			Select messages by group and message type, as bit masks (bit N selects group or type N).
+		*/
+		struct Filter
+		{
+			uint16_t groups = 0xFFFF;
+			uint16_t types  = 0xFFFF;
+
+			bool accepts(const word_t header) const
+			{
+				return ((groups >> ((header>>24) & 0xF)) & (types >> ((header>>28) & 0xF)) & 1u) != 0;
+			}
+
+			static Filter All()                       {return Filter();}
+			static Filter Group(uint8_t group)        {Filter f; f.groups = uint16_t(1u << (group & 0xF)); return f;}
+			static Filter Type (uint8_t messageType)  {Filter f; f.types  = uint16_t(1u << (messageType & 0xF)); return f;}
+
+			Filter &andGroup(uint8_t group)          {groups &= uint16_t(1u << (group & 0xF)); return *this;}
+			Filter &andType (uint8_t messageType)    {types  &= uint16_t(1u << (messageType & 0xF)); return *this;}
+		};
+
+		/*
+			Iterates over the messages accepted by a filter.
+		*/
+		class iterator
+		{
+		public:
+			iterator(const word_t *pos, const word_t *end, Filter filter) : pos(pos), end(end), filter(filter)    {skip();}
+
+			Message   operator* () const    {return Message{pos, Size(pos[0])};}
+			iterator &operator++()          {pos += Size(pos[0]); skip(); return *this;}
+
+			bool operator==(const iterator &o) const    {return pos == o.pos;}
+			bool operator!=(const iterator &o) const    {return pos != o.pos;}
+
+		private:
+			// Advance to the next accepted message; stop at the end or a truncated message.
+			void skip()
+			{
+				while (pos < end)
+				{
+					uint8_t size = Size(pos[0]);
+					if (size > end - pos) {pos = end; return;}
+					if (filter.accepts(pos[0])) return;
+					pos += size;
+				}
+				pos = end;
+			}
+
+			const word_t *pos, *end;
+			Filter        filter;
+		};
+
+		/*
+			A range of filtered messages, for range-based for loops.
+		*/
+		struct Range
+		{
+			iterator first, last;
+
+			iterator begin() const    {return first;}
+			iterator end  () const    {return last;}
+		};
+
+		/*
+			A message's position and classification, from index().
+		*/
+		struct Entry
+		{
+			uint32_t          offset; // In words, from the start of the stream
+			uint8_t           size;   // In words
+			uint8_t           group;
+			UMP::MESSAGE_TYPE type;   // As identified in the protocol
+		};
+
+	public:
+		UMP_Stream(const word_t *words, size_t wordCount)    : words(words), wordCount(wordCount) {}
+
+		/*
+			Iterate over all messages, or those accepted by a filter.
+		*/
+		iterator begin() const    {return iterator(words, words + wordCount, Filter());}
+		iterator end  () const    {return iterator(words + wordCount, words + wordCount, Filter());}
+
+		Range filter(Filter f) const    {return Range{iterator(words, words + wordCount, f), end()};}
+
+		/*
+			Classify messages in bulk, starting from word offset start.
+				Fills up to capacity entries and returns how many were filled;
+				next receives the offset to continue from.
+				Identification uses a table built once for the protocol, not per message.
+		*/
+		size_t index(Entry *entries, size_t capacity, const UMP::Protocol &protocol,
+			size_t start = 0, size_t *next = nullptr) const
+		{
+			UMP::MESSAGE_TYPE types[16];
+			for (uint32_t mt = 0; mt < 16; ++mt) types[mt] = UMP(mt << 28).identify(protocol);
+
+			size_t count = 0, pos = start;
+			while (count < capacity && pos < wordCount)
+			{
+				word_t  header = words[pos];
+				uint8_t size   = Size(header);
+				if (size > wordCount - pos) break;
+
+				entries[count++] = Entry{uint32_t(pos), size, uint8_t((header>>24) & 0xF), types[header>>28]};
+				pos += size;
+			}
+			if (next) *next = pos;
+			return count;
+		}
+
+		/*
+			Count the messages in the stream.
+		*/
+		size_t count() const
+		{
+			size_t n = 0;
+			for (size_t pos = 0; pos < wordCount; ++n)
+			{
+				uint8_t size = Size(words[pos]);
+				if (size > wordCount - pos) break;
+				pos += size;
+			}
+			return n;
+		}
+
+		/*
+			Number of words at the end of the buffer belonging to an incomplete message.
+				A receiver can keep these and prepend them to the next buffer.
+		*/
+		size_t truncated() const
+		{
+			size_t pos = 0;
+			while (pos < wordCount)
+			{
+				uint8_t size = Size(words[pos]);
+				if (size > wordCount - pos) return wordCount - pos;
+				pos += size;
+			}
+			return 0;
+		}
+
+		const word_t *data() const    {return words;}
+		size_t        size() const    {return wordCount;}
+
+		/*
+			Message size in words, from the first word.
+		*/
+		static uint8_t Size(word_t header)
+		{
+			// Two bits per message type:  size - 1.
+			return uint8_t(((0xFE950D40u >> ((header>>28) * 2)) & 3u) + 1u);
+		}
+
+	private:
+		const word_t *words;
+		size_t        wordCount;
+	};
+
+
+	/*
+		Appends packets to a buffer of words, using only as many words as each message needs.
+	*/
+	class UMP_StreamWriter
+	{
+	public:
+		UMP::word_t *words;
+		size_t       capacity;
+		size_t       length = 0;
+
+	public:
+		UMP_StreamWriter(UMP::word_t *words, size_t capacity)    : words(words), capacity(capacity) {}
+
+		/*
+			Append a message.  Returns false, writing nothing, if it doesn't fit.
+		*/
+		bool write(const UMP &packet)
+		{
+			uint8_t size = UMP_Stream::Size(packet.words[0]);
+			if (size > capacity - length) return false;
+			for (uint8_t i = 0; i < size; ++i) words[length++] = packet.words[i];
+			return true;
+		}
+
+		UMP_Stream stream() const    {return UMP_Stream(words, length);}
+		void       clear()           {length = 0;}
+	};
+}